@@ -0,0 +1,166 @@
+/*
+ * bench_hash.cc
+ *
+ *  Measure how fast positions can be hashed from scratch, in positions per
+ *  second, on a batch of random positions too large for the caches.  The
+ *  baseline is the loop hash used to have, over all 64 squares of the piece
+ *  map with a branch per square, against a table of the same layout.  It is
+ *  compared with ZobristHasher::hash one position at a time, which walks
+ *  the bitboards, and with the batch overload, which does so in lanes.
+ *
+ */
+#include <boardlib.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace boardlib;
+
+namespace {
+
+/*
+ * Make a FEN string with the pieces of the starting position, less a random
+ * number of them, on random squares.  The positions needn't be legal to be
+ * hashed, and being all different they keep the branch predictors from
+ * learning the batch, as they would from a corpus of real games.
+ */
+std::string random_fen(std::mt19937_64& random){
+	std::string pieces = "KkQqRRrrBBbbNNnnPPPPPPPPpppppppp";
+	std::shuffle(pieces.begin() + 2, pieces.end(), random);
+	pieces.resize(2 + random() % (pieces.size() - 1));
+	std::string board(kSquaresPerBoard, '1');
+	std::vector<int> squares(kSquaresPerBoard);
+	for(int i=0; i<kSquaresPerBoard; i++){
+		squares[i] = i;
+	}
+	std::shuffle(squares.begin(), squares.end(), random);
+	for(std::size_t i=0; i<pieces.size(); i++){
+		board[squares[i]] = pieces[i];
+	}
+	std::string fen;
+	for(int rank=7; rank>=0; rank--){
+		int empty = 0;
+		for(int file=0; file<8; file++){
+			const char piece = board[8*rank + file];
+			if(piece == '1'){
+				empty++;
+				continue;
+			}
+			if(empty){
+				fen += std::to_string(empty);
+				empty = 0;
+			}
+			fen += piece;
+		}
+		if(empty){
+			fen += std::to_string(empty);
+		}
+		fen += rank == 0?" ":"/";
+	}
+	return fen + (random() % 2?"w":"b") + " - - 0 1";
+}
+
+constexpr std::size_t kBatchSize = 1 << 16;
+
+/*
+ * A stand-in for ZobristTable, with a row of 14 entries per square, and the
+ * turn, castle rights and en passant square hashed as hash does.
+ */
+constexpr unsigned int kRowSize = 14;
+const std::array<ZobristKey, kSquaresPerBoard * kRowSize + 5> kTable =
+		generate_zobrist_numbers<kSquaresPerBoard * kRowSize + 5>(0x0123456789ABCDEFULL);
+
+ZobristKey hash_square_loop(const BoardState& state){
+	ZobristKey result = 0;
+	for(SquareIndex i=0; i<kSquaresPerBoard; i++){
+		const Piece piece = state.get_piece_at(i);
+		if(piece != Piece::NO_PIECE){
+			result ^= kTable[kRowSize*i + piece_index_of(piece)];
+		}
+	}
+	const std::size_t flags = kSquaresPerBoard * kRowSize;
+	if(state.get_whites_turn()){
+		result ^= kTable[flags];
+	}
+	if(state.get_white_castle_king()){
+		result ^= kTable[flags + 1];
+	}
+	if(state.get_white_castle_queen()){
+		result ^= kTable[flags + 2];
+	}
+	if(state.get_black_castle_king()){
+		result ^= kTable[flags + 3];
+	}
+	if(state.get_black_castle_queen()){
+		result ^= kTable[flags + 4];
+	}
+	if(state.get_en_passant_square() != kNoEnPassant){
+		const SquareIndex square = state.get_en_passant_square();
+		result ^= kTable[kRowSize*square + 12 + (square >= kSquaresPerBoard/2?1:0)];
+	}
+	return result;
+}
+
+/*
+ * Run body repeatedly for about a second and report positions per second.
+ */
+template<class Body>
+void report(const char* name, Body body){
+	using Clock = std::chrono::steady_clock;
+	std::size_t runs = 0;
+	const Clock::time_point start = Clock::now();
+	std::chrono::duration<double> elapsed;
+	do{
+		body();
+		runs++;
+		elapsed = Clock::now() - start;
+	}while(elapsed.count() < 1.0);
+	std::printf("%-24s %12.0f positions/s\n", name, runs * kBatchSize / elapsed.count());
+}
+
+} // namespace
+
+int main(){
+	std::mt19937_64 random(2024);
+	std::vector<BoardState> positions;
+	positions.reserve(kBatchSize);
+	for(std::size_t i=0; i<kBatchSize; i++){
+		positions.push_back(BoardState::from_fen(random_fen(random)));
+	}
+	std::vector<ZobristKey> keys(kBatchSize);
+	ZobristKey checksum = 0;
+
+	report("square loop (baseline)", [&](){
+		for(std::size_t i=0; i<kBatchSize; i++){
+			keys[i] = hash_square_loop(positions[i]);
+		}
+		checksum += keys.back();
+	});
+
+	report("hash", [&](){
+		for(std::size_t i=0; i<kBatchSize; i++){
+			keys[i] = ZobristHasher::hash(positions[i]);
+		}
+		checksum += keys.back();
+	});
+
+	report("hash (batch)", [&](){
+		ZobristHasher::hash(positions.data(), kBatchSize, keys.data());
+		checksum += keys.back();
+	});
+
+	std::vector<ZobristKey128> wide_keys(kBatchSize);
+	report("hash 128 (batch)", [&](){
+		ZobristHasher128::hash(positions.data(), kBatchSize, wide_keys.data());
+		checksum += wide_keys.back().high;
+	});
+
+	// Print the checksum so none of the work can be optimized away.
+	std::printf("checksum %016llx\n", (unsigned long long) checksum);
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * bench_multipv.cc
+ *
+ *  Measure the cost of MultiPV: search a few positions to a fixed depth
+ *  for 1, 2, 4, ... lines, once as a single MultiPV search and once as
+ *  that many separate single line searches, each leaving out the best
+ *  moves of the ones before it, and report the nodes and time of both.
+ *  The transposition table and the move ordering heuristics are cleared
+ *  before every search, so that each separate search pays for itself.
+ *
+ *  Usage: bench_multipv [depth [max_lines]]
+ *
+ */
+#include <boardlib.h>
+#include <evallib.h>
+#include <searchlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace boardlib;
+using namespace searchlib;
+
+namespace {
+
+const std::vector<std::string> kPositions = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"2r2rk1/pp1bqppp/2n1pn2/3p4/3P4/2PBPN2/P2N1PPP/R2Q1RK1 w - - 0 12",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+/*
+ * The nodes and time of finding some lines.
+ */
+struct Cost{
+	std::uint64_t nodes = 0;
+	std::chrono::duration<double> elapsed = std::chrono::duration<double>(0);
+};
+
+/*
+ * Search fen afresh with limits.
+ */
+SearchInfo search(Searcher& searcher, TranspositionTable& table, const std::string& fen,
+		const SearchLimits& limits, Cost& cost){
+	table.clear();
+	searcher.clear_heuristics();
+	BoardState board = BoardState::from_fen(fen);
+	const auto start = std::chrono::steady_clock::now();
+	const SearchInfo info = searcher.search(board, limits);
+	cost.elapsed += std::chrono::steady_clock::now() - start;
+	cost.nodes += info.nodes;
+	return info;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+	const int depth = argc > 1?std::atoi(argv[1]):8;
+	const unsigned max_lines = argc > 2?std::atoi(argv[2]):8;
+
+	const evallib::MaterialTable material_table;
+	TranspositionTable table(std::size_t(64) << 20);
+	Searcher searcher(material_table, table);
+	SearchLimits limits;
+	limits.depth = depth;
+	std::printf("%8s %6s %14s %10s %14s %10s %8s\n", "position", "lines", "multipv nodes",
+			"seconds", "separate nodes", "seconds", "ratio");
+	for(std::size_t position = 0; position < kPositions.size(); position++){
+		const std::string& fen = kPositions[position];
+		for(unsigned lines = 1; lines <= max_lines; lines *= 2){
+			Cost multi_pv;
+			searcher.set_multi_pv(lines);
+			search(searcher, table, fen, limits, multi_pv);
+
+			Cost separate;
+			searcher.set_multi_pv(1);
+			SearchLimits excluding = limits;
+			for(unsigned line = 0; line < lines; line++){
+				const SearchInfo info = search(searcher, table, fen, excluding, separate);
+				if(info.pv.empty()){
+					break;
+				}
+				excluding.excluded_moves.push_back(info.pv.front());
+			}
+			std::printf("%8zu %6u %14llu %10.3f %14llu %10.3f %8.2f\n", position, lines,
+					(unsigned long long) multi_pv.nodes, multi_pv.elapsed.count(),
+					(unsigned long long) separate.nodes, separate.elapsed.count(),
+					double(multi_pv.nodes) / separate.nodes);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * bench_prefetch.cc
+ *
+ *  Measure nodes per second of a make, probe, unmake loop against a
+ *  table much larger than the caches, with and without a prefetch hook.
+ *  There is no search yet, so the nodes are the positions of the games in
+ *  the corpus, and the table index is salted differently on every pass so
+ *  that each probe misses the cache as it would in a real search.
+ *
+ */
+#include <boardlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace boardlib;
+
+namespace {
+
+const std::string kStartingPosition =
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+const std::vector<std::string> kCorpus = {
+		// Morphy v. Duke of Brunswick and Count Isouard, Paris 1858.
+		"e2e4 e7e5 g1f3 d7d6 d2d4 c8g4 d4e5 g4f3 d1f3 d6e5 f1c4 g8f6 f3b3 "
+		"d8e7 b1c3 c7c6 c1g5 b7b5 c3b5 c6b5 c4b5 b8d7 e1c1 a8d8 d1d7 d8d7 "
+		"h1d1 e7e6 b5d7 f6d7 b3b8 d7b8 d1d8",
+		// Anderssen v. Kieseritzky, London 1851.
+		"e2e4 e7e5 f2f4 e5f4 f1c4 d8h4 e1f1 b7b5 c4b5 g8f6 g1f3 h4h6 d2d3 "
+		"f6h5 f3h4 h6g5 h4f5 c7c6 g2g4 h5f6 h1g1 c6b5 h2h4 g5g6 h4h5 g6g5 "
+		"d1f3 f6g8 c1f4 g5f6 b1c3 f8c5 c3d5 f6b2 f4d6 c5g1 e4e5 b2a1 f1e2 "
+		"b8a6 f5g7 e8d8 f3f6 g8f6 d6e7",
+};
+
+/*
+ * A 64 MiB table of cache line sized buckets, standing in for a
+ * transposition table.
+ */
+struct alignas(kCacheLineSize) Bucket{
+	ZobristKey keys[kCacheLineSize / sizeof(ZobristKey)];
+};
+
+struct Table{
+	std::vector<Bucket> buckets;
+	ZobristKey mask;
+	ZobristKey salt;
+
+	const Bucket& bucket_of(const ZobristKey key) const{
+		return buckets[(key ^ salt) & mask];
+	}
+	Bucket& bucket_of(const ZobristKey key){
+		return buckets[(key ^ salt) & mask];
+	}
+};
+
+void prefetch_bucket(const void* context, ZobristKey key){
+	__builtin_prefetch(&static_cast<const Table*>(context)->bucket_of(key));
+}
+
+/*
+ * Play through every game, probing and storing each position reached, and
+ * unmake back to the start.  Return the number of nodes visited.
+ */
+std::size_t run(const BoardState& start, const std::vector<std::vector<Move>>& games,
+		Table& table, const bool use_hook, ZobristKey& checksum){
+	std::size_t nodes = 0;
+	std::vector<MoveRecord> records;
+	for(const std::vector<Move>& moves : games){
+		BoardState board = start.copy();
+		board.set_prefetch_hook(use_hook?prefetch_bucket:nullptr, &table);
+		for(const Move& move : moves){
+			records.push_back(board.make_move<SearchPolicy>(move));
+			Bucket& bucket = table.bucket_of(board.get_hash());
+			checksum += bucket.keys[0];
+			bucket.keys[0] = board.get_hash();
+			nodes++;
+		}
+		while(!records.empty()){
+			board.unmake_move<SearchPolicy>(records.back());
+			records.pop_back();
+		}
+	}
+	return nodes;
+}
+
+} // namespace
+
+int main(){
+	std::vector<std::vector<Move>> games;
+	for(const std::string& game : kCorpus){
+		std::vector<Move> moves;
+		for(const std::string& uci : split_string(game, " ")){
+			moves.push_back(uci_to_move(uci));
+		}
+		games.push_back(moves);
+	}
+	const BoardState start = BoardState::from_fen(kStartingPosition);
+
+	Table table;
+	table.buckets.resize((64 << 20) / sizeof(Bucket));
+	table.mask = table.buckets.size() - 1;
+	ZobristKey checksum = 0;
+
+	for(const bool use_hook : {false, true, false, true}){
+		using Clock = std::chrono::steady_clock;
+		std::size_t nodes = 0;
+		const Clock::time_point start_time = Clock::now();
+		std::chrono::duration<double> elapsed;
+		do{
+			table.salt = table.salt * 6364136223846793005ULL + 1442695040888963407ULL;
+			nodes += run(start, games, table, use_hook, checksum);
+			elapsed = Clock::now() - start_time;
+		}while(elapsed.count() < 1.0);
+		std::printf("%-16s %12.0f nodes/s\n", use_hook?"with prefetch":"without prefetch",
+				nodes / elapsed.count());
+	}
+
+	// Print the checksum so none of the work can be optimized away.
+	std::printf("checksum %016llx\n", (unsigned long long) checksum);
+	return 0;
+}
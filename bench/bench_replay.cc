@@ -0,0 +1,108 @@
+/*
+ * bench_replay.cc
+ *
+ *  Measure how fast games that are known to be legal can be replayed, in
+ *  moves per second, comparing make_move with replay.
+ *
+ */
+#include <boardlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace boardlib;
+
+namespace {
+
+const std::string kStartingPosition =
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+/*
+ * The corpus: a few well known games in UCI notation, all from the
+ * starting position.
+ */
+const std::vector<std::string> kCorpus = {
+		// Morphy v. Duke of Brunswick and Count Isouard, Paris 1858.
+		"e2e4 e7e5 g1f3 d7d6 d2d4 c8g4 d4e5 g4f3 d1f3 d6e5 f1c4 g8f6 f3b3 "
+		"d8e7 b1c3 c7c6 c1g5 b7b5 c3b5 c6b5 c4b5 b8d7 e1c1 a8d8 d1d7 d8d7 "
+		"h1d1 e7e6 b5d7 f6d7 b3b8 d7b8 d1d8",
+		// Anderssen v. Kieseritzky, London 1851.
+		"e2e4 e7e5 f2f4 e5f4 f1c4 d8h4 e1f1 b7b5 c4b5 g8f6 g1f3 h4h6 d2d3 "
+		"f6h5 f3h4 h6g5 h4f5 c7c6 g2g4 h5f6 h1g1 c6b5 h2h4 g5g6 h4h5 g6g5 "
+		"d1f3 f6g8 c1f4 g5f6 b1c3 f8c5 c3d5 f6b2 f4d6 c5g1 e4e5 b2a1 f1e2 "
+		"b8a6 f5g7 e8d8 f3f6 g8f6 d6e7",
+		// A line with en passant, promotion and castling.
+		"e2e4 g8f6 e4e5 d7d5 e5d6 e7e6 d6c7 f8e7 c7b8q f6d5 b8a8 e8g8",
+};
+
+/*
+ * Run body repeatedly for about a second and report moves per second.
+ */
+template<class Body>
+void report(const char* name, const std::size_t moves_per_run, Body body){
+	using Clock = std::chrono::steady_clock;
+	std::size_t runs = 0;
+	const Clock::time_point start = Clock::now();
+	std::chrono::duration<double> elapsed;
+	do{
+		for(int i=0; i<100; i++){
+			body();
+		}
+		runs += 100;
+		elapsed = Clock::now() - start;
+	}while(elapsed.count() < 1.0);
+	std::printf("%-24s %12.0f moves/s\n", name,
+			runs * moves_per_run / elapsed.count());
+}
+
+} // namespace
+
+int main(){
+	std::vector<std::vector<Move>> games;
+	std::size_t total_moves = 0;
+	for(const std::string& game : kCorpus){
+		std::vector<Move> moves;
+		for(const std::string& uci : split_string(game, " ")){
+			moves.push_back(uci_to_move(uci));
+		}
+		total_moves += moves.size();
+		games.push_back(moves);
+	}
+	const BoardState start = BoardState::from_fen(kStartingPosition);
+	std::vector<ZobristKey> keys(total_moves);
+	ZobristKey checksum = 0;
+
+	report("make_move", total_moves, [&](){
+		for(const std::vector<Move>& moves : games){
+			BoardState board = start.copy();
+			for(const Move& move : moves){
+				board.make_move(move);
+			}
+			checksum += board.get_hash();
+		}
+	});
+
+	report("replay", total_moves, [&](){
+		for(const std::vector<Move>& moves : games){
+			BoardState board = start.copy();
+			board.replay(moves.data(), moves.size());
+			checksum += board.get_hash();
+		}
+	});
+
+	report("replay<ReplayPolicy>", total_moves, [&](){
+		ZobristKey* game_keys = keys.data();
+		for(const std::vector<Move>& moves : games){
+			BoardState board = start.copy();
+			board.replay<ReplayPolicy>(moves.data(), moves.size(), game_keys);
+			game_keys += moves.size();
+		}
+		checksum += keys.back();
+	});
+
+	// Print the checksum so none of the work can be optimized away.
+	std::printf("checksum %016llx\n", (unsigned long long) checksum);
+	return 0;
+}
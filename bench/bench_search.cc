@@ -0,0 +1,82 @@
+/*
+ * bench_search.cc
+ *
+ *  Measure single thread time to depth: search a few positions to a fixed
+ *  depth, clearing the transposition table and the move ordering
+ *  heuristics before each, and report the time, nodes, score and best move
+ *  of each and the totals.  Search parameters can be given by name, as
+ *  listed by get_parameter_info, to tune the selectivity.
+ *
+ *  Usage: bench_search [depth [Name=value ...]]
+ *
+ */
+#include <boardlib.h>
+#include <evallib.h>
+#include <searchlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace boardlib;
+using namespace searchlib;
+
+namespace {
+
+const std::vector<std::string> kPositions = {
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+		"2r2rk1/pp1bqppp/2n1pn2/3p4/3P4/2PBPN2/P2N1PPP/R2Q1RK1 w - - 0 12",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		"8/8/1p1r1k2/p1pPN1p1/P3KnP1/1P6/8/3R4 b - - 0 1",
+};
+
+} // namespace
+
+int main(int argc, char** argv){
+	const int depth = argc > 1?std::atoi(argv[1]):8;
+	SearchParameters parameters;
+	for(int i = 2; i < argc; i++){
+		const char* const equals = std::strchr(argv[i], '=');
+		bool found = false;
+		for(const ParameterInfo& info : get_parameter_info()){
+			if(equals != nullptr && std::string(argv[i], equals - argv[i]) == info.name){
+				parameters.*info.value = std::atoi(equals + 1);
+				found = true;
+			}
+		}
+		if(!found){
+			std::fprintf(stderr, "Unknown parameter %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	const evallib::MaterialTable material_table;
+	TranspositionTable table(std::size_t(64) << 20);
+	Searcher searcher(material_table, table);
+	searcher.set_parameters(parameters);
+	std::uint64_t nodes = 0;
+	std::chrono::duration<double> elapsed(0);
+	std::printf("%10s %14s %8s %6s\n", "seconds", "nodes", "score", "move");
+	for(const std::string& fen : kPositions){
+		table.clear();
+		searcher.clear_heuristics();
+		BoardState board = BoardState::from_fen(fen);
+		SearchLimits limits;
+		limits.depth = depth;
+		const auto start = std::chrono::steady_clock::now();
+		const SearchInfo info = searcher.search(board, limits);
+		const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		std::printf("%10.3f %14llu %8d %6s\n", seconds.count(), (unsigned long long) info.nodes,
+				info.score, info.pv.empty()?"-":move_to_uci(info.pv.front()).c_str());
+		nodes += info.nodes;
+		elapsed += seconds;
+	}
+	std::printf("%10.3f %14llu total\n", elapsed.count(), (unsigned long long) nodes);
+	return 0;
+}
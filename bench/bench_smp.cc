@@ -0,0 +1,98 @@
+/*
+ * bench_smp.cc
+ *
+ *  Measure parallel search time to depth: search a few middle game
+ *  positions to a fixed depth with 1, 2, 4, ... threads, and finally the
+ *  number given on the command line (by default the hardware concurrency),
+ *  clearing the transposition table before each position, and report the
+ *  total time, nodes, the speedup over one thread and the node overhead,
+ *  the nodes searched relative to one thread.  Lazy SMP and YBWC are both
+ *  measured unless a mode is given.
+ *
+ *  Usage: bench_smp [max_threads [depth [hash_mib [lazysmp|ybwc]]]]
+ *
+ */
+#include <boardlib.h>
+#include <evallib.h>
+#include <searchlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace boardlib;
+using namespace searchlib;
+
+namespace {
+
+const std::vector<std::string> kPositions = {
+		"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+		"2r2rk1/pp1bqppp/2n1pn2/3p4/3P4/2PBPN2/P2N1PPP/R2Q1RK1 w - - 0 12",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+const std::pair<std::string, ParallelMode> kModes[] = {
+		{"lazysmp", ParallelMode::LAZY_SMP},
+		{"ybwc", ParallelMode::YBWC},
+};
+
+void run(const evallib::MaterialTable& material_table, TranspositionTable& table,
+		const ParallelMode mode, const unsigned max_threads, const int depth){
+	double single_thread_seconds = 0;
+	std::uint64_t single_thread_nodes = 0;
+	std::printf("%8s %10s %14s %12s %8s %8s\n", "threads", "seconds", "nodes", "nps",
+			"speedup", "overhead");
+	// Double the threads each round, ending with max_threads whether or not
+	// it is a power of two.
+	for(unsigned threads = 1; threads <= max_threads;
+			threads = threads == max_threads?threads + 1:std::min(2*threads, max_threads)){
+		ParallelSearcher searcher(material_table, table, threads);
+		searcher.set_mode(mode);
+		std::uint64_t nodes = 0;
+		std::chrono::duration<double> elapsed(0);
+		for(const std::string& fen : kPositions){
+			table.clear(threads);
+			BoardState board = BoardState::from_fen(fen);
+			SearchLimits limits;
+			limits.depth = depth;
+			const auto start = std::chrono::steady_clock::now();
+			nodes += searcher.search(board, limits).nodes;
+			elapsed += std::chrono::steady_clock::now() - start;
+		}
+		if(threads == 1){
+			single_thread_seconds = elapsed.count();
+			single_thread_nodes = nodes;
+		}
+		std::printf("%8u %10.3f %14llu %12.0f %8.2f %8.2f\n", threads, elapsed.count(),
+				(unsigned long long) nodes, nodes / elapsed.count(),
+				single_thread_seconds / elapsed.count(), double(nodes) / single_thread_nodes);
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+	const unsigned max_threads = argc > 1?std::atoi(argv[1]):
+			std::max(1u, std::thread::hardware_concurrency());
+	const int depth = argc > 2?std::atoi(argv[2]):6;
+	const std::size_t hash = argc > 3?std::atoi(argv[3]):64;
+	const std::string only_mode = argc > 4?argv[4]:"";
+
+	const evallib::MaterialTable material_table;
+	TranspositionTable table(hash << 20, max_threads);
+	for(const auto& mode : kModes){
+		if(!only_mode.empty() && mode.first != only_mode){
+			continue;
+		}
+		std::printf("%s\n", mode.first.c_str());
+		run(material_table, table, mode.second, max_threads, depth);
+	}
+	return 0;
+}
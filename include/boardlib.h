@@ -10,6 +10,12 @@
 
 // Include for uint64_t and uint8_t types
 #include <boost/multiprecision/cpp_int.hpp>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace boardlib {
 
@@ -25,6 +31,13 @@ constexpr SquareIndex kRanksPerBoard = 8;
 constexpr SquareIndex kFilesPerBoard = 8;
 constexpr SquareIndex kNumberDistinctOfPiecesForZobrist = 14;
 
+/*
+ * The size in bytes of a cache line on the machines we target.  Data that is
+ * touched together at every search node is laid out to span as few lines as
+ * possible.
+ */
+constexpr std::size_t kCacheLineSize = 64;
+
 class BitBoard{
 private:
 	uint64_t value_;
@@ -274,6 +287,14 @@ public:
 				step_south().step_south().step_west();
 	}
 
+	/*
+	 * Return the set of squares that can be moved to by kings on this board.
+	 */
+	constexpr BitBoard king_step() const{
+		const BitBoard row = *this | step_east() | step_west();
+		return (row | row.step_north() | row.step_south()) ^ *this;
+	}
+
 };
 
 
@@ -314,90 +335,159 @@ std::string square_index_to_algebraic(const SquareIndex square);
  */
 SquareIndex algebraic_to_square_index(std::string algebraic);
 
+/*
+ * A Piece is encoded in four bits.  The low three bits are its PieceKind and
+ * the high bit is set for black pieces, so the kind and color of a piece can
+ * be read off with a mask and a shift.  Values 0 (NO_PIECE), 7, 8 and 15
+ * are not pieces.
+ */
 enum class Piece : unsigned char {
-	NO_PIECE,
-	WHITE_KING,
-	WHITE_QUEEN,
-	WHITE_BISHOP,
-	WHITE_KNIGHT,
-	WHITE_ROOK,
-	WHITE_PAWN,
-	WHITE_EN_PASSANT,
-	BLACK_KING,
-	BLACK_QUEEN,
-	BLACK_BISHOP,
-	BLACK_KNIGHT,
-	BLACK_ROOK,
-	BLACK_PAWN,
-	BLACK_EN_PASSANT
+	NO_PIECE = 0,
+	WHITE_KING = 1,
+	WHITE_QUEEN = 2,
+	WHITE_BISHOP = 3,
+	WHITE_KNIGHT = 4,
+	WHITE_ROOK = 5,
+	WHITE_PAWN = 6,
+	BLACK_KING = 9,
+	BLACK_QUEEN = 10,
+	BLACK_BISHOP = 11,
+	BLACK_KNIGHT = 12,
+	BLACK_ROOK = 13,
+	BLACK_PAWN = 14
+};
+
+/*
+ * The number of distinct values of the Piece encoding, including unused ones.
+ * Arrays indexed directly by Piece have this size.
+ */
+constexpr unsigned int kPieceEncodings = 16;
+
+/*
+ * The bits of the Piece encoding holding the PieceKind and the color.
+ */
+constexpr unsigned char kPieceKindMask = 0b0111;
+constexpr unsigned char kPieceColorBit = 0b1000;
+
+enum class PieceKind : unsigned char {
+	NO_PIECE = 0,
+	KING = 1,
+	QUEEN = 2,
+	BISHOP = 3,
+	KNIGHT = 4,
+	ROOK = 5,
+	PAWN = 6
+};
+
+enum class Color : unsigned char {
+	NO_COLOR,
+	WHITE,
+	BLACK
 };
 
 /*
  * Get the FEN character representation for a piece.  Represent color by case, with
- * whites capitalized and blacks lower case.  For *_EN_PASSANT pieces, return '*'.
- * For NO_PIECE, return '-'.
+ * whites capitalized and blacks lower case.  For NO_PIECE, return '-'.  This is
+ * a table lookup.
  */
-char piece_to_fen(const Piece piece);
+constexpr char piece_to_fen(const Piece piece){
+	constexpr char kFenChars[kPieceEncodings + 1] = "-KQBNRP??kqbnrp?";
+	return kFenChars[static_cast<unsigned char>(piece)];
+}
 
 /*
- * Convert a char, representing a piece in FEN notation, to a Piece.  Since
- * FEN does not indicate en passant in its board representation, instead
- * directly specifying the algebraic location of the en passant square in a
- * special section, this function does not handle en passant at all.
+ * Convert a char, representing a piece in FEN notation, to a Piece.
  */
 Piece fen_to_piece(const char piece_char);
 
 /*
  * Sometimes we want to use a Piece as an index into an array.
- * In such cases, use this function.  NO_PIECE is intentionally
- * the last index, so arrays that don't need it can simply have
- * size 14 instead of 15.
+ * In such cases, use this function.  Pieces get indices 0 through 11,
+ * with white and black pieces of the same kind adjacent, white first.
+ * NO_PIECE is 14, and 12 and 13 are left free for arrays that need
+ * a white and black slot for en passant.  This is a table lookup.
  */
-int piece_index_of(Piece piece);
+constexpr signed char kPieceIndices[kPieceEncodings] = {
+		14, 0, 2, 4, 6, 8, 10, -1, -1, 1, 3, 5, 7, 9, 11, -1};
+constexpr int piece_index_of(const Piece piece){
+	// The table is at namespace scope so that it isn't rebuilt on the
+	// stack at every call.
+	return kPieceIndices[static_cast<unsigned char>(piece)];
+}
 
-enum class PieceKind : unsigned char {
-	NO_PIECE,
-	KING,
-	QUEEN,
-	BISHOP,
-	KNIGHT,
-	ROOK,
-	PAWN,
-	EN_PASSANT
-};
+/*
+ * A MaterialKey holds the number of pieces of each kind and color on the
+ * board, four bits per piece in piece_index_of order.  Placing or removing
+ * a piece adds or subtracts the material_key_of that piece, so the key is
+ * exact and can be kept up to date incrementally.
+ */
+typedef uint64_t MaterialKey;
+
+/*
+ * Get the MaterialKey of a single piece.  NO_PIECE has key zero.
+ */
+constexpr MaterialKey material_key_of(const Piece piece){
+	return piece == Piece::NO_PIECE?0:MaterialKey(1) << (4*piece_index_of(piece));
+}
+
+/*
+ * Get the number of the given piece that a MaterialKey holds.
+ */
+constexpr unsigned int count_of(const MaterialKey key, const Piece piece){
+	return (key >> (4*piece_index_of(piece))) & 0xF;
+}
 
 /*
  * Return the kind of piece that piece is.  Piece kind is just a piece
  * with color information removed.
  */
-PieceKind kind_of(const Piece piece);
+constexpr PieceKind kind_of(const Piece piece){
+	return static_cast<PieceKind>(static_cast<unsigned char>(piece) & kPieceKindMask);
+}
 
 /*
  * Return true if and only if the given piece kind is a diagonal slider.
+ * Each of these tests a bit of a mask with one bit per PieceKind.
  */
-bool is_diagonal_slider(const PieceKind kind);
+constexpr bool is_diagonal_slider(const PieceKind kind){
+	return (0b00001100 >> static_cast<unsigned char>(kind)) & 1;
+}
 
 /*
  * Return true if and only if the given piece kind is a non-diagonal slider.
  */
-bool is_non_diagonal_slider(const PieceKind kind);
-
+constexpr bool is_non_diagonal_slider(const PieceKind kind){
+	return (0b00100100 >> static_cast<unsigned char>(kind)) & 1;
+}
 
 /*
  * Return true if and only if the given piece kind is a slider.
  */
-bool is_slider(const PieceKind kind);
+constexpr bool is_slider(const PieceKind kind){
+	return (0b00101100 >> static_cast<unsigned char>(kind)) & 1;
+}
 
-enum class Color : unsigned char {
-	NO_COLOR,
-	WHITE,
-	BLACK
-};
+/*
+ * Return the color of the given piece.  This is a table lookup, since
+ * NO_PIECE has no color.
+ */
+constexpr Color color_of(const Piece piece){
+	constexpr Color kColors[kPieceEncodings] = {Color::NO_COLOR,
+			Color::WHITE, Color::WHITE, Color::WHITE, Color::WHITE,
+			Color::WHITE, Color::WHITE, Color::NO_COLOR, Color::NO_COLOR,
+			Color::BLACK, Color::BLACK, Color::BLACK, Color::BLACK,
+			Color::BLACK, Color::BLACK, Color::NO_COLOR};
+	return kColors[static_cast<unsigned char>(piece)];
+}
 
 /*
- * Return the color of the given piece.
+ * Return the Piece of the given color and kind.  The color must be WHITE or
+ * BLACK.
  */
-Color color_of(const Piece piece);
+constexpr Piece make_piece(const Color color, const PieceKind kind){
+	return static_cast<Piece>(static_cast<unsigned char>(kind) |
+			(color == Color::BLACK?kPieceColorBit:0));
+}
 
 constexpr BitBoard kEmpty = BitBoard(0x0000000000000000ULL);
 constexpr BitBoard kFull = BitBoard(0xFFFFFFFFFFFFFFFFULL);
@@ -500,6 +590,30 @@ constexpr BitBoard kRank7 = BitBoard(0x00FF000000000000ULL);
 constexpr BitBoard kRank8 = BitBoard(0xFF00000000000000ULL);
 constexpr BitBoard kRanks[8] = {kRank1, kRank2, kRank3, kRank4, kRank5, kRank6, kRank7, kRank8};
 
+/*
+ * The bit scans are inline because every loop over the squares of a
+ * BitBoard runs them once per square.
+ */
+inline SquareIndex BitBoard::greatest_square_index() const{
+	// TODO: Potentially not portable.
+	return value_ == 0?0:(SquareIndex) (63 - __builtin_clzll(value_));
+}
+
+inline BitBoard BitBoard::least_significant_1_bit() const{
+	return BitBoard(value_ & (-value_));
+}
+
+inline BitBoard BitBoard::pop_least_significant_1_bit(){
+	decltype(value_) temp_value = value_ & (-value_);
+	value_ ^= temp_value;
+	return BitBoard(temp_value);
+}
+
+inline SquareIndex BitBoard::population_count() const{
+	// TODO: Potentially not portable.
+	return (SquareIndex) __builtin_popcountll(value_);
+}
+
 /*
  * Return a new BitBoard that is the result of a call to step_east on the current
  * one, without affecting the current one.
@@ -726,6 +840,7 @@ private:
 	// The BoardState, of which BoardStateCore forms the core,
 	// should have access to private members.
 	friend class BoardState;
+	template<class Key> friend class BasicZobristHasher;
 
 	/*
 	 * BitBoards to store piece sets.  Each of the 64 bits represents a square.  The square contains a piece of
@@ -739,12 +854,13 @@ private:
 	BitBoard pawns_;
 	BitBoard white_;
 	BitBoard black_;
+
 	/*
-	 * The constraint that only one square can be the en passant square at any given time
-	 * is not enforced.  It will be up to the make and unmake methods to ensure board states
-	 * are always legal.
+	 * The square a pawn may capture onto en passant, or kNoEnPassant.  It
+	 * is not a piece and is not in any of the BitBoards above, so occupancy
+	 * is just white_ | black_.
 	 */
-	BitBoard en_passant_;
+	SquareIndex en_passant_square_;
 
 	/*
 	 * If whites_turn_ is true, it's white's turn.  Otherwise, it's black's turn.
@@ -824,31 +940,70 @@ public:
 };
 
 /*
- * A record of a previous board state along with its hash value, used
- * for detecting repetition.
+ * A frozen run of the record of previous board states.  Segments are
+ * immutable once built and chain to their parent, so the record of a game
+ * can be shared by any number of BoardStates (for example one per search
+ * thread) through reference counting, without being copied.
+ *
+ * The record is a compact array of Zobrist keys, one per halfmove.  The full
+ * BoardStateCores are kept alongside only when the BoardState that built
+ * the segment was verifying repetitions.
  */
-class RecordEntry{
+class RecordSegment{
 private:
-	ZobristKey hash_;
-	BoardStateCore state_;
+	/*
+	 * The older part of the record, or null if this segment starts the game.
+	 */
+	std::shared_ptr<const RecordSegment> parent_;
+
+	/*
+	 * The number of entries of the parent_ chain that precede this segment.
+	 * It may be less than the parent_ chain's full length, if the BoardState
+	 * that froze this segment had unmade moves into the shared record first.
+	 */
+	std::size_t parent_length_;
+
+	/*
+	 * The entries of this segment, oldest first.  The cores_ are empty
+	 * unless repetitions were being verified.
+	 */
+	std::vector<ZobristKey> keys_;
+	std::vector<BoardStateCore> cores_;
+
+	/*
+	 * Find the segment of the chain ending in this one that holds index.
+	 */
+	const RecordSegment& segment_of(const std::size_t index) const;
+
 public:
+	RecordSegment(const RecordSegment& rhs) = delete;
+	RecordSegment& operator=(const RecordSegment& rhs) = delete;
+
+	/*
+	 * Freeze keys and cores, which directly follow the first parent_length
+	 * entries of parent.
+	 */
+	RecordSegment(std::shared_ptr<const RecordSegment> parent,
+			const std::size_t parent_length, std::vector<ZobristKey>&& keys,
+			std::vector<BoardStateCore>&& cores);
+
 	/*
-	 * RecordEntry can be copied.
+	 * Get the key or core at index of the chain ending in this segment,
+	 * counting from the oldest entry at index 0.  Cores are only available
+	 * if they were recorded.
 	 */
-	RecordEntry(const RecordEntry& rhs) = default;
-	RecordEntry& operator=(const RecordEntry& rhs) = default;
+	ZobristKey key_at(const std::size_t index) const;
+	const BoardStateCore& core_at(const std::size_t index) const;
 
 	/*
-	 * Construct a RecordEntry from a BoardStateCore and its pre-computed
-	 * hash value.
+	 * Get the number of parent_ chain entries that precede this segment.
 	 */
-	RecordEntry(const ZobristKey hash, const BoardStateCore state);
+	std::size_t get_parent_length() const;
 
 	/*
-	 * Equality comparison works for RecordEntries.  It's also fast
-	 * because it checks the hash value first.
+	 * Get the segment this one continues.
 	 */
-	bool operator==(const RecordEntry& rhs) const;
+	const std::shared_ptr<const RecordSegment>& get_parent() const;
 };
 
 struct Move{
@@ -880,13 +1035,66 @@ struct Move{
 
 constexpr Move kNoMove = Move();
 
+/*
+ * Convert between a Move and UCI long algebraic notation, such as "e2e4"
+ * or "e7e8q".  The color of a promotion piece is taken from the rank it
+ * promotes on.
+ */
+Move uci_to_move(const std::string& uci);
+std::string move_to_uci(const Move& move);
+
+/*
+ * No legal position has more than 218 moves, so a MoveList of this capacity
+ * never overflows.
+ */
+constexpr std::size_t kMaxMoves = 256;
+
+/*
+ * A fixed capacity list of moves, cheap enough to keep on the stack at
+ * every node of a search.
+ */
+struct MoveList{
+	std::array<Move, kMaxMoves> moves;
+	std::size_t size = 0;
+
+	void push_back(const Move& move){
+		moves[size++] = move;
+	}
+	void clear(){
+		size = 0;
+	}
+	bool empty() const{
+		return size == 0;
+	}
+	Move& operator[](const std::size_t i){
+		return moves[i];
+	}
+	const Move& operator[](const std::size_t i) const{
+		return moves[i];
+	}
+	Move* begin(){
+		return moves.data();
+	}
+	Move* end(){
+		return moves.data() + size;
+	}
+	const Move* begin() const{
+		return moves.data();
+	}
+	const Move* end() const{
+		return moves.data() + size;
+	}
+	bool contains(const Move& move) const;
+};
+
 /*
  * A MoveRecord contains all the information needed to undo a move and to
  * compute the change in Zobrist hash value for a move.
  */
 struct MoveRecord{
 	/*
-	 * All members are zero (or the equivalent for their type) by default.
+	 * All members are zero (or the equivalent for their type) by default,
+	 * except the en passant squares, which are kNoEnPassant.
 	 */
 	constexpr MoveRecord() : from_square(0), to_square(0), captured_square(0),
 			castled_from_square(0), castled_to_square(0), moved_piece(Piece::NO_PIECE),
@@ -894,9 +1102,8 @@ struct MoveRecord{
 			castled_piece(Piece::NO_PIECE),
 			lost_white_castle_king(false), lost_white_castle_queen(false),
 			lost_black_castle_king(false), lost_black_castle_queen(false),
-			en_passant_square_before(0), en_passant_square_after(0),
-			en_passant_piece_before(Piece::NO_PIECE),
-			en_passant_piece_after(Piece::NO_PIECE), halfmove_clock_before(0),
+			en_passant_square_before(kNoEnPassant),
+			en_passant_square_after(kNoEnPassant), halfmove_clock_before(0),
 			threefold_repetition_clock_before(0), halfmove_clock_after(0),
 			threefold_repetition_clock_after(0) {}
 
@@ -947,22 +1154,11 @@ struct MoveRecord{
 	bool lost_black_castle_king;
 	bool lost_black_castle_queen;
 
-	// The square of the available en passant capture before the move.  If
-	// no en passant capture was available, en_passant_piece_before will be
-	// NO_PIECE.
+	// The square of the available en passant capture before and after the
+	// move, respectively, or kNoEnPassant if none was available.
 	SquareIndex en_passant_square_before;
-
-	// The square of the available en passant capture after the move.  If
-	// no en passant capture is available, en_passant_piece_after will be
-	// NO_PIECE.
 	SquareIndex en_passant_square_after;
 
-	// WHITE_EN_PASSANT or BLACK_EN_PASSANT if en passant was available before
-	// and after the move, respectively. Set to NO_PIECE if no en passant capture
-	// is available.
-	Piece en_passant_piece_before;
-	Piece en_passant_piece_after;
-
 	// The values of the various forced draw clocks before and after the move.
 	unsigned int halfmove_clock_before;
 	unsigned int threefold_repetition_clock_before;
@@ -970,6 +1166,28 @@ struct MoveRecord{
 	unsigned int threefold_repetition_clock_after;
 };
 
+/*
+ * A NullMoveRecord contains all the information needed to undo a null move
+ * and to compute the change in Zobrist hash value for it.  A null move only
+ * passes the turn, so this is much less than a MoveRecord.
+ */
+struct NullMoveRecord{
+	/*
+	 * All members are zero by default, except the en passant square, which
+	 * is kNoEnPassant.
+	 */
+	constexpr NullMoveRecord() : en_passant_square_before(kNoEnPassant),
+			halfmove_clock_before(0), threefold_repetition_clock_before(0) {}
+
+	// The en passant square before the null move, which is cleared by it, or
+	// kNoEnPassant if no en passant capture was available.
+	SquareIndex en_passant_square_before;
+
+	// The values of the forced draw clocks before the null move.
+	unsigned int halfmove_clock_before;
+	unsigned int threefold_repetition_clock_before;
+};
+
 /*
  * Split a string on a delimiter and put the resulting tokens
  * in output.
@@ -984,11 +1202,150 @@ std::vector<std::string> split_string(const std::string& string_to_split,
 		const std::string& delimiter);
 
 
+/*
+ * The extended move tables of a BoardState.  These are large (a kilobyte per
+ * board) and are not needed by every user of BoardState, so they live on the
+ * heap and are only allocated when first computed.
+ *
+ * Each table represents a 64 x 64 boolean table, with a 1 at position [i,j] of the
+ * move_targets (move_origins) table if and only if there
+ * exists an extended move from (to) square i to (from) square j.
+ * By updating these tables with every new extended move, we can avoid
+ * re-generating all extended moves at every turn, instead simply
+ * reading them off the table.  The idea is that keeping these
+ * tables up-to-date can be done in an efficient way.
+ *
+ * Note the difference between a move and an extended move.  The set of
+ * extended moves at a given position is a superset of the set of moves not
+ * including promotions.  A pair (i, j) is an extended move if and only if
+ * any of the following is true:
+ *
+ * 1. The exists a move from square index i to square index j, or
+ *
+ * 2. There would exist a move from square index i to square index j
+ *    under some change to the occupancy of j, for example by changing
+ *    the color of the piece at j or by placing a piece at j, or
+ *
+ * 3. Any of the above would hold if the rules allowed moving into check.
+ *
+ * 4. Any of the above would hold if it were the other player's turn.
+ *
+ * The extended move is defined to allow for the localization of changes to
+ * the available moves.  When reading off moves, it's necessary to determine
+ * whether each extended move is an actual move.
+ */
+struct MoveTables{
+	std::array<BitBoard, kSquaresPerBoard> move_targets;
+	std::array<BitBoard, kSquaresPerBoard> move_origins;
+
+	bool operator==(const MoveTables& rhs) const;
+};
+
+/*
+ * The record of previous board states grows in chunks of this many entries
+ * (or by doubling, once it is larger than one chunk).  Nothing is allocated
+ * until the first move is made.
+ */
+constexpr std::size_t kRecordChunkSize = 64;
+
+/*
+ * A function called with a context pointer and the Zobrist key of a
+ * position that is about to be reached.  See BoardState::set_prefetch_hook.
+ */
+typedef void (*PrefetchHook)(const void* context, ZobristKey key);
+
+/*
+ * Policies select which incremental state make and unmake maintain, so that
+ * each tool pays only for what it reads.  They are passed to the make and
+ * unmake member functions of BoardState as template parameters, and the
+ * work for every flag that is false compiles away.  The board (pieces, turn,
+ * castle rights and en passant) is always maintained.
+ *
+ *   kHash           the Zobrist hash_.
+ *   kClocks         the halfmove and repetition clocks and the counters.
+ *   kHistory        the record of previous keys, for repetition detection.
+ *   kMoveTables     the extended move tables.
+ *   kRedundantData  the redundant BitBoards and king trackers that move
+ *                   generation and attack detection use.
+ *   kPrefetch       calling the prefetch hook, if one is set, with the
+ *                   key of the position a move is about to reach.
+ *   kEvalKeys       the keys that evaluation caches are indexed by: the
+ *                   pawn key and the material key.
+ *
+ * Whatever a policy leaves out goes stale while moves made with it are on
+ * the board.  Since unmaking with the same policy skips the same work, the
+ * stale state is exactly as it was once those moves are unmade again, so
+ * a search or perft may use a lean policy below a position kept with
+ * FullPolicy.
+ */
+struct FullPolicy{
+	static constexpr bool kHash = true;
+	static constexpr bool kClocks = true;
+	static constexpr bool kHistory = true;
+	static constexpr bool kMoveTables = true;
+	static constexpr bool kRedundantData = true;
+	static constexpr bool kPrefetch = true;
+	static constexpr bool kEvalKeys = true;
+};
+
+/*
+ * Search needs keys, clocks and history for transpositions and draws, and
+ * the redundant data for move generation, but not the move tables.
+ */
+struct SearchPolicy{
+	static constexpr bool kHash = true;
+	static constexpr bool kClocks = true;
+	static constexpr bool kHistory = true;
+	static constexpr bool kMoveTables = false;
+	static constexpr bool kRedundantData = true;
+	static constexpr bool kPrefetch = true;
+	static constexpr bool kEvalKeys = true;
+};
+
+/*
+ * Perft and other tools that only need legal moves keep the redundant data
+ * and nothing else.
+ */
+struct PerftPolicy{
+	static constexpr bool kHash = false;
+	static constexpr bool kClocks = false;
+	static constexpr bool kHistory = false;
+	static constexpr bool kMoveTables = false;
+	static constexpr bool kRedundantData = true;
+	static constexpr bool kPrefetch = false;
+	static constexpr bool kEvalKeys = false;
+};
+
+/*
+ * Replaying games that are known to be legal, for example to index them
+ * by position, needs keys and clocks but no move generation.
+ */
+struct ReplayPolicy{
+	static constexpr bool kHash = true;
+	static constexpr bool kClocks = true;
+	static constexpr bool kHistory = false;
+	static constexpr bool kMoveTables = false;
+	static constexpr bool kRedundantData = false;
+	static constexpr bool kPrefetch = false;
+	static constexpr bool kEvalKeys = false;
+};
+
 /*
  * A BoardStateCore with some additional redundant information used in search and move generation.
+ *
+ * Members are laid out by how often they are touched.  Everything that make
+ * and unmake read or write at every node (the core_, hash_, clocks and the
+ * tracked squares) sits in the first two cache lines.  The piece_map_ gets
+ * the third line to itself, followed by the redundant BitBoards.  The record
+ * of previous states and the move tables are cold and live on the heap,
+ * allocated lazily, so that a BoardState that has not made any moves is just
+ * a few cache lines and thousands of them can be held at once.
  */
-class BoardState{
+class alignas(kCacheLineSize) BoardState{
 private:
+	// The hashers read the piece sets of core_ directly.
+	template<class Key> friend class BasicZobristHasher;
+
 	/*
 	 * The core_ contains the non-redundant information needed to determine
 	 * the positions of all pieces and castle rights.  It does not contain information
@@ -997,38 +1354,35 @@ private:
 	BoardStateCore core_;
 
 	/*
-	 * Redundant BitBoards useful for move generation.
+	 * The Zobrist hash value of the current position.
 	 */
-	BitBoard occupied_;
-	BitBoard unoccupied_;
-	BitBoard own_;
-	BitBoard opponent_;
-	BitBoard own_king_;
-	BitBoard opponent_non_diagonal_sliders_;
-	BitBoard opponent_diagonal_sliders_;
-	BitBoard opponent_kinghts_;
-	BitBoard opponent_pawns_;
-	BitBoard own_complement_;
+	ZobristKey hash_;
 
 	/*
-	 * Redundant king tracker.
+	 * The Zobrist hash value of the pawns alone, which indexes the pawn
+	 * hash table.
 	 */
-	SquareIndex own_king_square_;
+	ZobristKey pawn_key_;
 
 	/*
-	 * The halfmove_clock_ is the number of halfmoves relevant to the 50 move rule.
+	 * The number of pieces of each kind and color, which indexes the
+	 * material table.
 	 */
-	unsigned int halfmove_clock_;
+	MaterialKey material_key_;
 
 	/*
-	 * The fullmove_counter_ is the number of full moves in the game so far.
+	 * The prefetch hook and the context it is called with, or null.  See
+	 * set_prefetch_hook.
 	 */
-	unsigned int fullmove_counter_;
+	PrefetchHook prefetch_hook_;
+	const void* prefetch_context_;
 
 	/*
-	 * The halfmove_counter_ is the number of halfmoves in the game so far.
+	 * The halfmove_clock_ is the number of halfmoves relevant to the 50 move rule.
+	 * The forced draw clocks are 16 bits so that the hot data fits in two
+	 * cache lines; the 75 move rule ends a game long before they overflow.
 	 */
-	unsigned int halfmove_counter_;
+	uint16_t halfmove_clock_;
 
 	/*
 	 * The threefold_repetition_clock_ measures the number of halfmoves since the
@@ -1037,64 +1391,104 @@ private:
 	 * does not because castle rights are not relevant to the 50 move rule, but are
 	 * relevant to the threefold repetition rule.
 	 */
-	unsigned int threefold_repetition_clock_;
+	uint16_t threefold_repetition_clock_;
 
 	/*
-	 * Redundant map from SquareIndex to the Piece at that square.
+	 * The fullmove_counter_ is the number of full moves in the game so far.
 	 */
-	std::array<Piece, kSquaresPerBoard> piece_map_;
+	unsigned int fullmove_counter_;
 
 	/*
-	 * The Zobrist hash value of the current position.
+	 * The halfmove_counter_ is the number of halfmoves in the game so far.
 	 */
-	ZobristKey hash_;
+	unsigned int halfmove_counter_;
+
+	/*
+	 * Redundant king trackers.
+	 */
+	SquareIndex own_king_square_;
+	SquareIndex opponent_king_square_;
+
+	/*
+	 * If true, the record keeps full BoardStateCores as well as keys, and
+	 * repetitions found by key are confirmed by comparing cores.
+	 */
+	bool verify_repetition_;
+
+	/*
+	 * Redundant map from SquareIndex to the Piece at that square.  It starts
+	 * on its own cache line, directly after the hot data.
+	 */
+	alignas(kCacheLineSize) std::array<Piece, kSquaresPerBoard> piece_map_;
+
+	/*
+	 * Redundant BitBoards useful for move generation.  These are kept up to
+	 * date by raw_place_piece, raw_unplace_piece and flip_turn, so they are
+	 * always consistent with core_.  The own and opponent sets come in pairs
+	 * so that passing the turn is a swap.
+	 */
+	BitBoard occupied_;
+	BitBoard unoccupied_;
+	BitBoard own_;
+	BitBoard opponent_;
+	BitBoard own_complement_;
+	BitBoard own_king_;
+	BitBoard own_non_diagonal_sliders_;
+	BitBoard opponent_non_diagonal_sliders_;
+	BitBoard own_diagonal_sliders_;
+	BitBoard opponent_diagonal_sliders_;
+	BitBoard own_knights_;
+	BitBoard opponent_knights_;
+	BitBoard own_pawns_;
+	BitBoard opponent_pawns_;
 
 	/*
 	 * A record of previous board states, used to detect repetition.  Only the
-	 * core and Zobrist hash value are stored.
+	 * Zobrist hash value is stored, unless verify_repetition_ is set, in which
+	 * case the core is stored as well.  The record is split in two.
+	 * The older part is an immutable chain of RecordSegments that may be
+	 * shared with other BoardStates, of which the first shared_record_length_
+	 * entries belong to this BoardState.  The newer part, record_keys_ (and
+	 * record_cores_), is private
+	 * to this BoardState and is where make and unmake push and pop.  Its
+	 * storage is reserved in chunks of kRecordChunkSize as moves are made,
+	 * never up front.
 	 */
-	std::vector<RecordEntry> record_;
+	std::shared_ptr<const RecordSegment> shared_record_;
+	std::size_t shared_record_length_;
+	std::vector<ZobristKey> record_keys_;
+	std::vector<BoardStateCore> record_cores_;
 
 	/*
-	 * Redundant storage of the current en passant square for fast reference when
-	 * updating en passant rights.
+	 * The extended move tables, or null if they have never been computed.
 	 */
-	SquareIndex en_passant_square_;
+	std::unique_ptr<MoveTables> move_tables_;
+
+	/*
+	 * Append the current hash_ (and core_, if verifying repetitions) to the
+	 * record, growing its storage by a chunk if it is full.
+	 */
+	void push_record();
 
 	/*
-	 * These tables index available extended moves.  Each one represents a
-	 * 64 x 64 boolean table, with a 1 at position [i,j] of the
-	 * move_targets_ (move_origins_) table if and only if there
-	 * exists an extended move from (to) square i to (from) square j.
-	 * By updating these tables with every new extended move, we can avoid
-	 * re-generating all extended moves at every turn, instead simply
-	 * reading them off the table.  The idea is that keeping these
-	 * tables up-to-date can be done in an efficient way.
-	 *
-	 * Note the difference between a move and an extended move.  The set of
-	 * extended moves at a given position is a superset of the set of moves not
-	 * including promotions.  A pair (i, j) is an extended move if and only if
-	 * any of the following is true:
-	 *
-	 * 1. The exists a move from square index i to square index j, or
-	 *
-	 * 2. There would exist a move from square index i to square index j
-	 *    under some change to the occupancy of j, for example by changing
-	 *    the color of the piece at j or by placing a piece at j, or
-	 *
-	 * 3. Any of the above would hold if the rules allowed moving into check.
-	 *
-	 * 4. Any of the above would hold if it were the other player's turn.
-	 *
-	 * The extended move is defined to allow for the localization of changes to
-	 * the available moves.  When reading off moves, it's necessary to determine
-	 * whether each extended move is an actual move.
-	 *
-	 */
-	std::array<BitBoard, kSquaresPerBoard> move_targets_;
-	std::array<BitBoard, kSquaresPerBoard> move_origins_;
+	 * Remove the newest entry of the record, which may belong to the
+	 * shared part.
+	 */
+	void pop_record();
 
+	/*
+	 * Get the total number of entries in the record, shared and private.
+	 */
+	std::size_t get_record_length() const;
 
+	/*
+	 * Get the recorded key (or core) of the state plies_ago halfmoves before
+	 * the current one.  The shared part of the record is searched too, so the
+	 * whole game is visible.  Requires 0 < plies_ago <= get_record_length(),
+	 * and cores are only available if verify_repetition_ is set.
+	 */
+	ZobristKey get_record_key(const std::size_t plies_ago) const;
+	const BoardStateCore& get_record_core(const std::size_t plies_ago) const;
 
 	/*
 	 * Break the rank_string into tokens.  It is assumed that rank_string
@@ -1103,53 +1497,62 @@ private:
 	 */
 	static std::vector<std::string> tokenize_fen_rank(std::string rank_string);
 
+	/*
+	 * Add or remove piece at square from the redundant
+	 * BitBoards and king trackers.  Toggling is its own inverse, so this
+	 * serves both placing and unplacing.
+	 */
+	void toggle_redundant_data(const Piece piece, const SquareIndex square);
+
+	/*
+	 * Pass the turn to the other side, swapping the own and opponent
+	 * redundant data to match if the Policy maintains it.
+	 */
+	template<class Policy = FullPolicy>
+	void flip_turn();
+
 	/*
 	 * Place a piece at square, with no safety checks of any kind.
 	 * It is up to the caller to ensure that the desired square is
-	 * empty and that the placement is otherwise legal.  The
-	 * move tables, en_passant_square_, and hash_ will not be updated.
+	 * empty and that the placement is otherwise legal.  The redundant
+	 * BitBoards are updated, but the
+	 * move tables, en passant square, and hash_ will not be updated.
 	 * The caller must update them after the call to ensure a
-	 * consistent BoardState.
+	 * consistent BoardState.  The redundant BitBoards are left alone if
+	 * the Policy doesn't maintain them.
 	 */
+	template<class Policy = FullPolicy>
 	void raw_place_piece(const Piece piece, const SquareIndex square);
 
 	/*
 	 * Remove a piece at a square, with no safety checks of any kind.
 	 * It is up to the caller to ensure that the desired square contains a
-	 * piece and that removal is otherwise legal. The
-	 * move tables, en_passant_square_, and hash_ will not be updated.
+	 * piece and that removal is otherwise legal.  The redundant BitBoards
+	 * are updated, but the
+	 * move tables, en passant square, and hash_ will not be updated.
 	 * The caller must update them after the call to ensure a
 	 * consistent BoardState.  Two signatures exists, depending on whether
 	 * the Piece is known to the caller already.
 	 */
 	void raw_unplace_piece(const SquareIndex square);
+	template<class Policy = FullPolicy>
 	void raw_unplace_piece(const Piece piece, const SquareIndex square);
 
 	/*
-	 * Set the en passant square, with no safety checks of any kind.  It's
-	 * up to the caller to ensure the desired square is a valid en passant
-	 * square.  The available_moves_ and hash_ will not be updated.  The
-	 * caller must update them after the call to ensure a consistent
-	 * BoardState.
+	 * Fill in the parts of record that don't depend on the kind of move:
+	 * the en passant square before it, the castle rights it loses and, if
+	 * the Policy maintains them, the clocks.  The squares and pieces must
+	 * already be set.
 	 */
-	void raw_set_en_passant(Piece piece, SquareIndex square);
+	template<class Policy>
+	void finish_move_record(MoveRecord& record) const;
 
 	/*
-	 * Remove the en passant square. The available_moves_ and hash_ will
-	 * not be updated.  The caller must update them after the call to ensure
-	 * a consistent BoardState.
+	 * Like compute_move_record, but only pawn and king moves go through
+	 * the full analysis.  Used by replay.
 	 */
-	void raw_unset_en_passant();
-
-	/*
-	 * Change the en passant square.  Valid even if no en passant square
-	 * currently exists. The available_moves_ and hash_ will
-	 * not be updated.  The caller must update them after the call to ensure
-	 * a consistent BoardState.
-	 */
-	void raw_change_en_passant(Piece en_passant_piece_before,
-			Piece en_passant_piece_after,
-			SquareIndex en_passant_square_after);
+	template<class Policy>
+	MoveRecord compute_trusted_move_record(const Move& move) const;
 
 public:
 	/*
@@ -1167,8 +1570,8 @@ public:
 	BoardState(BoardState&& rhs);
 
 	/*
-	 * Default constructor sets everything to zero except en_passant_square_,
-	 * which is set to kNoEnPassant.
+	 * Default constructor sets everything to zero except the en passant
+	 * square, which is set to kNoEnPassant.  Nothing is allocated on the heap.
 	 */
 	BoardState();
 
@@ -1178,22 +1581,137 @@ public:
 	bool operator==(const BoardState& rhs) const;
 
 	/*
-	 * Explicitly copy BoardState.
+	 * Explicitly copy BoardState.  The shared part of the record is shared
+	 * with the copy rather than copied, so the cost is proportional to the
+	 * length of the private part only.
 	 */
 	BoardState copy() const;
 
+	/*
+	 * Move the private part of the record into the shared part, so that
+	 * subsequent calls to copy() cost O(1) in the length of the game.  Call
+	 * this once before handing copies of a game position to worker threads.
+	 */
+	void share_record();
+
+	/*
+	 * Share the record and then copy.  This is the cheap way to clone a
+	 * position for a worker.
+	 */
+	BoardState fork();
+
 	/*
 	 * Get the hash value for the current BoardState.
 	 */
 	ZobristKey get_hash() const;
 
+	/*
+	 * Compute the hash value of the position the given legal move would
+	 * reach, without making it.  Search can use this to start fetching the
+	 * transposition table entry of a child before deciding to visit it.
+	 */
+	ZobristKey key_after(const Move& move) const;
+
+	/*
+	 * Generate the legal moves of the current position into moves,
+	 * replacing what was there.  Castling is the king moving two squares.
+	 * This reads only the core, so it works whatever policy the moves so
+	 * far were made with.
+	 */
+	void generate_moves(MoveList& moves) const;
+
+	/*
+	 * Return true if the side to move is in check.
+	 */
+	bool is_check() const;
+
+	/*
+	 * Get the squares of the pieces of the given color that attack square,
+	 * counting only pieces on occupied and with sliders blocked by
+	 * occupied.  Pass a modified occupied to look through or around
+	 * pieces.
+	 */
+	BitBoard get_attackers(const SquareIndex square, const bool white,
+			const BitBoard occupied) const;
+
+	/*
+	 * Get the hash value of the pawns alone.
+	 */
+	ZobristKey get_pawn_key() const;
+
+	/*
+	 * Get the number of pieces of each kind and color.
+	 */
+	MaterialKey get_material_key() const;
+
+	/*
+	 * Get the set of squares holding the given piece.
+	 */
+	BitBoard get_pieces(const Piece piece) const;
+
+	/*
+	 * Get the set of occupied squares.
+	 */
+	BitBoard get_occupied() const;
+
+	/*
+	 * Set a hook to be called at the start of every make (and null move)
+	 * whose Policy has kPrefetch set, with context and the key of the
+	 * position about to be reached, before any of the board is changed.
+	 * The hook is meant to prefetch the transposition table bucket and any
+	 * evaluation caches for that key, so that the memory latency is hidden
+	 * behind the work of making the move.  Pass null to remove it.  Copies
+	 * get the same hook.
+	 */
+	void set_prefetch_hook(PrefetchHook hook, const void* context);
+
+	/*
+	 * Turn full-state verification of repetitions on or off.  With it on, the
+	 * record stores every BoardStateCore as well as its key, and a key match
+	 * only counts as a repetition if the cores match too.  It can only be
+	 * changed while the record is empty, since it decides what gets recorded.
+	 */
+	void set_verify_repetition(const bool value);
+
+	/*
+	 * Return true if the current position has occurred at least count times
+	 * in the game, counting the current occurrence.  So is_repetition(2) is
+	 * the usual test in search and is_repetition(3) is the threefold
+	 * repetition rule.  Only the keys of positions with the same side to move
+	 * since the last irreversible move (threefold_repetition_clock_ halfmoves)
+	 * are scanned.
+	 */
+	bool is_repetition(const int count) const;
+
+	/*
+	 * Return true if the 50 move rule applies, that is if 100 halfmoves have
+	 * passed without a capture or pawn move.  Whether the last move was
+	 * checkmate, which takes precedence, is not considered.
+	 */
+	bool is_fifty_move_draw() const;
+
+	/*
+	 * Return true if neither side has the material to deliver checkmate: no
+	 * pawns, rooks or queens on the board, and either at most one minor piece
+	 * or only bishops all on squares of the same color.
+	 */
+	bool is_insufficient_material() const;
+
+	/*
+	 * Return true if the position is drawn by repetition (repetition_count
+	 * occurrences, as in is_repetition), the 50 move rule, or insufficient
+	 * material.  These are ordered cheapest first.
+	 */
+	bool is_draw(const int repetition_count) const;
+
 	/*
 	 * Get the piece located at square
 	 */
 	Piece get_piece_at(const SquareIndex square) const;
 
 	/*
-	 * Getters and setters
+	 * Getters and setters.  The setters do not update the redundant data;
+	 * call update_redundant_data when done with them.
 	 */
 	bool get_whites_turn() const;
 	void set_whites_turn(const bool value);
@@ -1205,15 +1723,21 @@ public:
 	void set_black_castle_king(const bool value);
 	bool get_black_castle_queen() const;
 	void set_black_castle_queen(const bool value);
+	SquareIndex get_en_passant_square() const;
+	void set_en_passant_square(const SquareIndex value);
 
 	/*
-	 * Make the redundant bitboards consistent with the current core_.
+	 * Make the redundant bitboards consistent with the current core_ by
+	 * recomputing them from scratch.  Making and unmaking moves keeps them
+	 * consistent incrementally, so this is only needed after using the
+	 * setters above, for example when setting up a position.
 	 */
 	void update_redundant_data();
 
 	/*
 	 * Compute the available moves based on current state and set
-	 * the corresponding members.
+	 * the corresponding members.  The move tables are allocated by the
+	 * first call, so BoardStates that never need them never pay for them.
 	 */
 	void compute_move_tables();
 
@@ -1239,27 +1763,61 @@ public:
 
 
 	/*
-	 * Update current this BoardState based on given MoveRecord.
+	 * Update current this BoardState based on given MoveRecord.  This and
+	 * the make and unmake functions below maintain the incremental state
+	 * selected by the Policy (see FullPolicy).
 	 */
+	template<class Policy = FullPolicy>
 	void apply_move_record(const MoveRecord& record);
 
 	/*
 	 * Create the MoveRecord corresponding to the given move and
-	 * this BoardState.  Legality is assumed, not checked.
+	 * this BoardState.  Legality is assumed, not checked.  The clocks in
+	 * the record are only filled in if the Policy maintains them.
 	 */
-	MoveRecord compute_move_record(const Move& move);
+	template<class Policy = FullPolicy>
+	MoveRecord compute_move_record(const Move& move) const;
 
 	/*
 	 * Make the given Move and return the corresponding MoveRecord.
 	 */
+	template<class Policy = FullPolicy>
 	MoveRecord make_move(const Move move);
 
+	/*
+	 * Make the n moves in moves, one after another, without returning their
+	 * records, so they can't be unmade.  The moves are trusted to be legal,
+	 * and the quiet moves and captures of pieces other than pawns and kings
+	 * skip the analysis of special moves.  If keys is not null, the Zobrist
+	 * hash value after each move is written to keys[0] through keys[n-1].
+	 * Use ReplayPolicy when the position will not be searched afterwards.
+	 */
+	template<class Policy = FullPolicy>
+	void replay(const Move* moves, const std::size_t n, ZobristKey* keys = nullptr);
+
 
 	/*
 	 * Un-make a recorded move and update all members accordingly.
 	 */
+	template<class Policy = FullPolicy>
 	void unmake_move(const MoveRecord& record);
 
+	/*
+	 * Pass the turn without moving a piece, for null move pruning, and
+	 * return the record needed to undo it.  Any en passant opportunity is
+	 * lost.  The halfmove_clock_ advances as for a quiet move, but the
+	 * threefold_repetition_clock_ is reset, since a position reached through
+	 * a null move must not count as a repetition of one before it.
+	 */
+	template<class Policy = FullPolicy>
+	NullMoveRecord make_null_move();
+
+	/*
+	 * Un-make a null move and update all members accordingly.
+	 */
+	template<class Policy = FullPolicy>
+	void unmake_null_move(const NullMoveRecord& record);
+
 	/*
 	 * Create a BoardState from a FEN formatted string. This function
 	 * doesn't need to be fast.
@@ -1363,12 +1921,68 @@ public:
 
 
 /*
- * ZobristHasher implements Zobrist hashing and updating.
+ * A 128 bit Zobrist key, for position databases large enough that 64 bit
+ * keys collide.  The low half is the 64 bit key of the same position, so
+ * either can be derived from a 128 bit key.
  */
-class ZobristHasher{
+struct ZobristKey128{
+	ZobristKey low;
+	ZobristKey high;
+
+	constexpr ZobristKey128() : low(0), high(0){}
+	constexpr ZobristKey128(const ZobristKey low, const ZobristKey high) :
+			low(low), high(high){}
+
+	constexpr ZobristKey128 operator^(const ZobristKey128 rhs) const{
+		return ZobristKey128(low ^ rhs.low, high ^ rhs.high);
+	}
+	constexpr ZobristKey128& operator^=(const ZobristKey128 rhs){
+		low ^= rhs.low;
+		high ^= rhs.high;
+		return *this;
+	}
+	constexpr bool operator==(const ZobristKey128 rhs) const{
+		return low==rhs.low && high==rhs.high;
+	}
+	constexpr bool operator!=(const ZobristKey128 rhs) const{
+		return !(*this == rhs);
+	}
+	constexpr bool operator<(const ZobristKey128 rhs) const{
+		return high < rhs.high || (high == rhs.high && low < rhs.low);
+	}
+};
+
+/*
+ * Generate n pseudorandom numbers from seed with splitmix64, at compile time.
+ */
+template<std::size_t n>
+constexpr std::array<ZobristKey, n> generate_zobrist_numbers(ZobristKey seed){
+	std::array<ZobristKey, n> result = {};
+	for(std::size_t i=0; i<n; i++){
+		seed += 0x9E3779B97F4A7C15ULL;
+		ZobristKey z = seed;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		result[i] = z ^ (z >> 31);
+	}
+	return result;
+}
+
+/*
+ * The random numbers of Zobrist hashing.  The numbers of 64 bit keys are a
+ * fixed table, which also gives the low halves of 128 bit keys; the high
+ * halves come from a second table generated at compile time.
+ */
+class ZobristTable{
 private:
+	template<class Key> friend class BasicZobristHasher;
 
+	/*
+	 * Each square has a row of this many entries: one per piece, ordered
+	 * by piece_index_of, then two for an en passant square on it.
+	 */
 	static constexpr unsigned int kNumberOfPieceTypes = 14;
+	static constexpr unsigned int kEnPassantIndex = 12;
 	static constexpr ZobristKey kZobristWhiteCastleKing = 0x4813FCAA66F292EDULL;
 	static constexpr ZobristKey kZobristWhiteCastleQueen = 0xA8B3B3DEEFBFFA3DULL;
 	static constexpr ZobristKey kZobristBlackCastleKing = 0xC0426A0CE5346059ULL;
@@ -1825,19 +2439,124 @@ private:
 					0x6BBE026B5E4D0C25ULL
 			};
 
+	/*
+	 * The high halves are indexed like zobrist_table_, followed by one
+	 * entry for the turn and one for each castle right.
+	 */
+	static constexpr unsigned int kWhitesTurnIndex = kSquaresPerBoard*kNumberOfPieceTypes;
+	static constexpr unsigned int kWhiteCastleKingIndex = kWhitesTurnIndex + 1;
+	static constexpr unsigned int kWhiteCastleQueenIndex = kWhitesTurnIndex + 2;
+	static constexpr unsigned int kBlackCastleKingIndex = kWhitesTurnIndex + 3;
+	static constexpr unsigned int kBlackCastleQueenIndex = kWhitesTurnIndex + 4;
+	static constexpr std::array<ZobristKey, kWhitesTurnIndex + 5> high_table_ =
+			generate_zobrist_numbers<kWhitesTurnIndex + 5>(0x5A4E2C1B0F3D6987ULL);
+};
+
+/*
+ * BasicZobristHasher implements Zobrist hashing and updating for keys of
+ * type Key, which is ZobristKey or ZobristKey128.  BoardState keeps a 64 bit
+ * key; 128 bit keys are for tools that index or deduplicate very many
+ * positions, which compute them with hash or keep them alongside a board
+ * with update.
+ */
+template<class Key>
+class BasicZobristHasher{
+private:
+	typedef ZobristTable Table;
+
+	/*
+	 * Make the key with the given 64 bit number as its low half, and the
+	 * high half at high_index, if Key has one.
+	 */
+	static Key make_entry(const ZobristKey low, const unsigned int high_index){
+		if constexpr(std::is_same<Key, ZobristKey128>::value){
+			return ZobristKey128(low, Table::high_table_[high_index]);
+		}else{
+			return low;
+		}
+	}
 
 	/*
 	 * Get the Zobrist number for a particular square and piece.  Used
-	 * only for computing Zobrist hash values.
+	 * only for computing Zobrist hash values.  Each square has a row of
+	 * kNumberOfPieceTypes entries, ordered by piece_index_of.
 	 */
-	static ZobristKey get_table_entry(SquareIndex square, Piece piece);
+	static Key get_table_entry(const SquareIndex square, const Piece piece){
+		const unsigned int index = Table::kNumberOfPieceTypes * square + piece_index_of(piece);
+		return make_entry(Table::zobrist_table_[index], index);
+	}
+
+	/*
+	 * Get the Zobrist number for an en passant square.  Squares on the
+	 * third rank (behind a white pawn) use the first en passant entry and
+	 * squares on the sixth rank the second.
+	 */
+	static Key get_en_passant_entry(const SquareIndex square){
+		const unsigned int index = Table::kNumberOfPieceTypes * square +
+				Table::kEnPassantIndex + (square >= kSquaresPerBoard/2?1:0);
+		return make_entry(Table::zobrist_table_[index], index);
+	}
+
+	/*
+	 * Get the Zobrist numbers for the turn and the castle rights.
+	 */
+	static Key get_whites_turn_entry(){
+		return make_entry(Table::kZobristWhitesTurn, Table::kWhitesTurnIndex);
+	}
+	static Key get_white_castle_king_entry(){
+		return make_entry(Table::kZobristWhiteCastleKing, Table::kWhiteCastleKingIndex);
+	}
+	static Key get_white_castle_queen_entry(){
+		return make_entry(Table::kZobristWhiteCastleQueen, Table::kWhiteCastleQueenIndex);
+	}
+	static Key get_black_castle_king_entry(){
+		return make_entry(Table::kZobristBlackCastleKing, Table::kBlackCastleKingIndex);
+	}
+	static Key get_black_castle_queen_entry(){
+		return make_entry(Table::kZobristBlackCastleQueen, Table::kBlackCastleQueenIndex);
+	}
+
+	/*
+	 * Compute the part of the hash value for the turn, the castle rights
+	 * and the en passant square, which hash adds to that of the pieces.
+	 */
+	static Key hash_flags(const BoardState& state);
+
+	/*
+	 * The number of pieces hashed, and the sets of each, read straight
+	 * from the core of the state in the order of kHashedPieces.
+	 */
+	static constexpr std::size_t kNumberOfHashedPieces = 12;
+	static void get_piece_sets(const BoardState& state, BitBoard* sets);
 
 public:
 
 	/*
 	 * Compute the Zobrist hash value for the board state.
 	 */
-	static ZobristKey hash(const BoardState& state);
+	static Key hash(const BoardState& state);
+
+	/*
+	 * Compute the Zobrist hash values of the n board states starting at
+	 * states into keys.  This is for hashing many positions from scratch,
+	 * such as a corpus.  Boards are hashed a few at a time, in lanes that
+	 * walk the same piece type together, so that the table loads of one
+	 * board overlap those of the others, and the boards ahead are
+	 * prefetched.
+	 */
+	static void hash(const BoardState* states, const std::size_t n, Key* keys);
+
+	/*
+	 * Compute the Zobrist hash value of the pawns of the board state alone.
+	 * It uses the same table entries as hash.
+	 */
+	static Key hash_pawns(const BoardState& state);
+
+	/*
+	 * Compute the updated pawn hash value for making or unmaking the move
+	 * recorded in record.  Like update, this is its own inverse.
+	 */
+	static Key update_pawns(const Key previous_key, const MoveRecord& record);
 
 	/*
 	 * Compute the updated Zobrist hash value if a board with
@@ -1846,9 +2565,103 @@ public:
 	 * move_record.  The operation of zobrist updating by a MoveRecord
 	 * is its own inverse.
 	 */
-	static ZobristKey update(const ZobristKey previous_key, const MoveRecord& record);
+	static Key update(const Key previous_key, const MoveRecord& record);
+
+	/*
+	 * Compute the updated Zobrist hash value for making or unmaking the
+	 * null move recorded in record.  Like update, this is its own inverse.
+	 */
+	static Key update(const Key previous_key, const NullMoveRecord& record);
 };
 
+typedef BasicZobristHasher<ZobristKey> ZobristHasher;
+typedef BasicZobristHasher<ZobristKey128> ZobristHasher128;
+
+/*
+ * PolyglotHasher computes keys in the scheme of the Polyglot opening book
+ * format, for reading books and talking to other tools.  It differs from
+ * ZobristHasher in its random numbers, in their layout, and in keying an en
+ * passant square only when a pawn of the side to move stands next to the
+ * pawn that just made a double step.
+ *
+ * The random numbers are by default the Random64 array published with the
+ * format, which src/polyglot.inc holds, but others can be given, say for
+ * testing.  Entries are laid out as in the format:
+ * 64 per piece, in the order black pawn, white pawn, black knight, ...,
+ * white king, then the four castle rights, eight en passant files and the
+ * turn.
+ */
+class PolyglotHasher{
+public:
+	static constexpr unsigned int kRandomTableSize = 781;
+	typedef std::array<ZobristKey, kRandomTableSize> RandomTable;
+
+private:
+	static constexpr unsigned int kCastleIndex = 768;
+	static constexpr unsigned int kEnPassantIndex = 772;
+	static constexpr unsigned int kTurnIndex = 780;
+
+	RandomTable random_;
+
+	/*
+	 * Get the random number for a piece on a square.
+	 */
+	ZobristKey get_piece_entry(const SquareIndex square, const Piece piece) const{
+		// The Polyglot piece order, indexed by PieceKind.
+		constexpr unsigned int kKindOrder[] = {0, 5, 4, 2, 1, 3, 0};
+		return random_[64*(2*kKindOrder[static_cast<unsigned char>(kind_of(piece))] +
+				(color_of(piece) == Color::WHITE?1:0)) + square];
+	}
+
+	/*
+	 * Get the random number for the en passant square, if a pawn of the
+	 * side to capture, from capturers, stands next to the pawn that made
+	 * the double step, and zero otherwise.
+	 */
+	ZobristKey get_en_passant_entry(const SquareIndex square, const BitBoard capturers) const;
+
+public:
+	/*
+	 * Construct a hasher from the published Random64 array.
+	 */
+	PolyglotHasher();
+
+	/*
+	 * Construct a hasher from a Random64 array of its own.
+	 */
+	explicit PolyglotHasher(const RandomTable& random);
+
+	/*
+	 * Construct a hasher from a file holding the Random64 array as
+	 * hexadecimal numbers starting with 0x, in order.  Anything else in
+	 * the file is ignored, so the array can be copied straight out of C
+	 * source.  Throw if the file can't be read or holds too few numbers.
+	 */
+	static PolyglotHasher from_file(const std::string& path);
+
+	/*
+	 * Compute the Polyglot key of the board state.
+	 */
+	ZobristKey hash(const BoardState& state) const;
+
+	/*
+	 * Compute the updated key for making or unmaking the move recorded in
+	 * record, where state is the board with the move made.  Whether en
+	 * passant squares count depends on the pawns around them, which is why
+	 * the board is needed.
+	 */
+	ZobristKey update(const ZobristKey previous_key, const BoardState& state,
+			const MoveRecord& record) const;
+
+	/*
+	 * Compute the updated key for making or unmaking the null move recorded
+	 * in record, where state is the board with the null move made.
+	 */
+	ZobristKey update(const ZobristKey previous_key, const BoardState& state,
+			const NullMoveRecord& record) const;
+};
+
+
 
 
 
@@ -1856,4 +2669,18 @@ public:
 
 
 } // namespace boardlib
+
+/*
+ * Hash a ZobristKey128 for unordered containers.  Its halves are already
+ * random, so either will do.
+ */
+namespace std {
+template<>
+struct hash<boardlib::ZobristKey128>{
+	size_t operator()(const boardlib::ZobristKey128& key) const{
+		return key.high;
+	}
+};
+} // namespace std
+
 #endif /* SRC_BOARDLIB_H_ */
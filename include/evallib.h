@@ -0,0 +1,261 @@
+/*
+ * evallib.h
+ *
+ *  Evaluation terms and the caches that make them cheap to compute at
+ *  every node.
+ */
+
+#ifndef SRC_EVALLIB_H_
+#define SRC_EVALLIB_H_
+
+#include <boardlib.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace evallib {
+
+using boardlib::BitBoard;
+using boardlib::BoardState;
+using boardlib::MaterialKey;
+using boardlib::ZobristKey;
+
+/*
+ * A score in centipawns from white's point of view, with separate middle
+ * game and endgame values to be blended by game phase.
+ */
+struct Score{
+	int mg;
+	int eg;
+
+	constexpr Score() : mg(0), eg(0){}
+	constexpr Score(int mg, int eg) : mg(mg), eg(eg){}
+
+	constexpr Score operator+(const Score rhs) const{
+		return Score(mg + rhs.mg, eg + rhs.eg);
+	}
+	constexpr Score operator-(const Score rhs) const{
+		return Score(mg - rhs.mg, eg - rhs.eg);
+	}
+	constexpr Score operator*(const int n) const{
+		return Score(mg * n, eg * n);
+	}
+	Score& operator+=(const Score rhs){
+		mg += rhs.mg;
+		eg += rhs.eg;
+		return *this;
+	}
+	constexpr bool operator==(const Score rhs) const{
+		return mg==rhs.mg && eg==rhs.eg;
+	}
+};
+
+/*
+ * The result of evaluating a pawn structure.  The BitBoards hold the pawns
+ * of both colors that have each property; intersect them with one side's
+ * pawns to get that side's.  An entry is exactly one cache line.
+ *
+ *   passed    pawns with no enemy pawn ahead of them on their own file or
+ *             an adjacent one, and no friendly pawn ahead on their own.
+ *   isolated  pawns with no friendly pawn on an adjacent file.
+ *   doubled   pawns with a friendly pawn ahead of them on their own file.
+ *   backward  pawns that are not isolated, whose friendly neighbors are
+ *             all ahead of them, and whose stop square is attacked by an
+ *             enemy pawn.
+ */
+struct alignas(boardlib::kCacheLineSize) PawnEntry{
+	ZobristKey key;
+	BitBoard passed;
+	BitBoard isolated;
+	BitBoard doubled;
+	BitBoard backward;
+	Score score;
+};
+
+/*
+ * Evaluate the pawn structure given by the sets of white and black pawns,
+ * and fill in everything in entry but the key.
+ */
+void evaluate_pawns(const BitBoard white_pawns, const BitBoard black_pawns,
+		PawnEntry& entry);
+
+/*
+ * A fixed size, always replace cache of pawn structure evaluations, indexed
+ * by the pawn key of BoardState.  Pawn structures change rarely during
+ * search, so nearly every probe hits.
+ */
+class PawnHashTable{
+private:
+	std::vector<PawnEntry> entries_;
+	ZobristKey mask_;
+
+	/*
+	 * Statistics for measuring the hit rate.
+	 */
+	std::uint64_t probes_;
+	std::uint64_t hits_;
+
+public:
+	/*
+	 * Create a table of size_in_bytes, rounded down to a power of two
+	 * number of entries (at least one).
+	 */
+	explicit PawnHashTable(const std::size_t size_in_bytes);
+
+	/*
+	 * Get the evaluation of the pawn structure of state, computing and
+	 * storing it if it isn't in the table.  The reference is valid until
+	 * the next probe.
+	 */
+	const PawnEntry& probe(const BoardState& state);
+
+	/*
+	 * Get the address of the entry for key, for prefetching.
+	 */
+	const PawnEntry* entry_of(const ZobristKey key) const{
+		return &entries_[key & mask_];
+	}
+
+	/*
+	 * Empty the table and reset the statistics.
+	 */
+	void clear();
+
+	/*
+	 * Statistics since construction or the last clear.
+	 */
+	std::uint64_t get_probes() const;
+	std::uint64_t get_hits() const;
+	double get_hit_rate() const;
+};
+
+/*
+ * Game phase runs from kMaxPhase, with all the pieces on the board, down to
+ * zero with only kings and pawns.  Minor pieces count one, rooks two and
+ * queens four.
+ */
+constexpr int kMaxPhase = 24;
+
+/*
+ * Scale factors reduce the advantage of the side that is ahead in material
+ * configurations that are hard to win, out of kScaleNormal.
+ */
+constexpr int kScaleNormal = 64;
+constexpr int kScaleDraw = 0;
+
+/*
+ * The least value of a won specialized endgame.
+ */
+constexpr int kKnownWin = 10000;
+
+/*
+ * Material configurations with a specialized evaluation, which replaces
+ * the normal one.  See evaluate_endgame.
+ *
+ *   NONE              use the normal evaluation.
+ *   WHITE_MATES_KING  black has a bare king and white has a queen or rook.
+ *   BLACK_MATES_KING  the same with the colors reversed.
+ */
+enum class Endgame : unsigned char {
+	NONE,
+	WHITE_MATES_KING,
+	BLACK_MATES_KING
+};
+
+/*
+ * What is known about a material configuration.  The imbalance holds the
+ * adjustments to the plain piece values that depend on the other pieces
+ * on the board, such as the bishop pair, from white's point of view.
+ * scale[0] applies when white is ahead and scale[1] when black is.
+ */
+struct MaterialEntry{
+	Score imbalance;
+	unsigned char phase;
+	unsigned char scale[2];
+	Endgame endgame;
+};
+
+/*
+ * Compute the material entry of a configuration from scratch.
+ */
+MaterialEntry evaluate_material(const MaterialKey key);
+
+/*
+ * Blend the middle game and endgame values of a score by the phase of
+ * material, and scale the result by the scale factor of the side it favors.
+ */
+int blend(const Score score, const MaterialEntry& material);
+
+/*
+ * Evaluate a position whose material entry has a specialized endgame, from
+ * white's point of view.
+ */
+int evaluate_endgame(const BoardState& state, const MaterialEntry& material);
+
+/*
+ * A table with an entry for every material configuration with at most the
+ * starting number of each piece, directly indexed by piece counts, so that
+ * a lookup is a little arithmetic and one load.  Configurations with extra
+ * pieces from promotion are rare and are evaluated on the fly.  It takes a
+ * few megabytes and is built once, at construction.
+ */
+class MaterialTable{
+private:
+	std::vector<MaterialEntry> entries_;
+
+public:
+	MaterialTable();
+
+	/*
+	 * Get the index of the entry for key, or -1 if the table has none.
+	 */
+	static int index_of(const MaterialKey key);
+
+	/*
+	 * Get the entry for the material configuration given by key.
+	 */
+	MaterialEntry probe(const MaterialKey key) const;
+};
+
+/*
+ * The middle game and endgame values of each kind of piece.
+ */
+constexpr Score kPawnScore = Score(90, 120);
+constexpr Score kKnightScore = Score(320, 300);
+constexpr Score kBishopScore = Score(330, 320);
+constexpr Score kRookScore = Score(500, 550);
+constexpr Score kQueenScore = Score(900, 980);
+
+/*
+ * Evaluate piece placement and plain material, from white's point of view.
+ * Pieces score by how central they are, and the king by shelter in the
+ * middle game and by centralization in the endgame.
+ */
+Score evaluate_pieces(const BoardState& state);
+
+/*
+ * The static evaluation used by search.  It combines material, imbalance,
+ * pawn structure and piece placement through the caches above, or uses the
+ * specialized endgame evaluation when there is one.  Each search thread
+ * needs its own Evaluator, since the pawn hash table isn't shared, but the
+ * material table can be.
+ */
+class Evaluator{
+private:
+	const MaterialTable& material_table_;
+	PawnHashTable pawn_table_;
+
+public:
+	Evaluator(const MaterialTable& material_table, const std::size_t pawn_table_size);
+
+	/*
+	 * Evaluate state in centipawns from the point of view of the side to
+	 * move.  Wins in specialized endgames are worth at least kKnownWin.
+	 */
+	int evaluate(const BoardState& state);
+
+	const PawnHashTable& get_pawn_table() const;
+};
+
+} // namespace evallib
+#endif /* SRC_EVALLIB_H_ */
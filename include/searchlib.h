@@ -0,0 +1,1037 @@
+/*
+ * searchlib.h
+ *
+ *  Game tree search on top of boardlib's make and unmake and evallib's
+ *  evaluation.
+ */
+
+#ifndef SRC_SEARCHLIB_H_
+#define SRC_SEARCHLIB_H_
+
+#include <boardlib.h>
+#include <evallib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace searchlib {
+
+using boardlib::BoardState;
+using boardlib::Move;
+using boardlib::MoveList;
+using boardlib::Piece;
+using boardlib::SquareIndex;
+using boardlib::ZobristKey;
+
+/*
+ * The deepest ply search can reach, counted from the root.
+ */
+constexpr int kMaxPly = 128;
+
+/*
+ * Scores are in centipawns from the point of view of the side to move.
+ * Being mated at ply n scores -(kMateScore - n), so shorter mates score
+ * further from zero, and every score lies strictly inside kInfinity.
+ */
+constexpr int kMateScore = 32000;
+constexpr int kInfinity = 32001;
+
+/*
+ * Return true if score is a mate score, for either side.
+ */
+constexpr bool is_mate_score(const int score){
+	return score >= kMateScore - kMaxPly || score <= -(kMateScore - kMaxPly);
+}
+
+/*
+ * Pack a Move into 16 bits, as six bits each of the from and to squares and
+ * the four bits of the promotion Piece.  kNoMove packs to zero.
+ */
+constexpr std::uint16_t pack_move(const Move& move){
+	return std::uint16_t(move.from_square | (move.to_square << 6) |
+			(static_cast<unsigned>(move.promotion) << 12));
+}
+constexpr Move unpack_move(const std::uint16_t packed){
+	return Move(packed & 63, (packed >> 6) & 63, static_cast<boardlib::Piece>(packed >> 12));
+}
+
+/*
+ * What a stored score says about the true score.  A search that failed low
+ * gives an UPPER bound, one that failed high a LOWER bound.  NONE marks an
+ * empty entry.
+ */
+enum class Bound : unsigned char {
+	NONE,
+	UPPER,
+	LOWER,
+	EXACT
+};
+
+/*
+ * The contents of a transposition table entry, unpacked.  Mate scores are
+ * stored relative to the node they were found at, not the root; see
+ * score_to_table and score_from_table.
+ */
+struct TableEntry{
+	Move move;
+	int score = 0;
+	int depth = 0;
+	Bound bound = Bound::NONE;
+};
+
+/*
+ * Convert a mate score between distance from the root, as search uses, and
+ * distance from the node at ply, as the table stores, so that an entry is
+ * valid wherever the position is reached.
+ */
+constexpr int score_to_table(const int score, const int ply){
+	return score >= kMateScore - kMaxPly?score + ply:
+			score <= -(kMateScore - kMaxPly)?score - ply:score;
+}
+constexpr int score_from_table(const int score, const int ply){
+	return score >= kMateScore - kMaxPly?score - ply:
+			score <= -(kMateScore - kMaxPly)?score + ply:score;
+}
+
+/*
+ * A transposition table shared by every search thread, without locks.
+ *
+ * The table is an array of clusters, each one cache line holding
+ * kClusterSize entries, and a key selects a cluster by its low bits.  An
+ * entry is two 64 bit words: the data (packed move, score, depth, bound
+ * and the generation it was written in) and a check word holding the key
+ * XOR the data.  Writers store both words with plain atomic stores, so a
+ * racing reader may see the data of one write and the check of another,
+ * but then the XOR doesn't give back the key and the probe misses.  The
+ * check word doubles as the key fragment of more compact schemes, but
+ * verifies all 64 bits.
+ *
+ * Storing replaces the entry with the same key if there is one, and
+ * otherwise the entry worth least, where an entry is worth its depth less
+ * kAgeWeight for every generation since it was written.  Call new_search
+ * before each search to start a generation.
+ */
+class TranspositionTable{
+public:
+	static constexpr std::size_t kClusterSize = 4;
+	static constexpr int kAgeWeight = 8;
+
+	struct alignas(boardlib::kCacheLineSize) Cluster{
+		std::atomic<std::uint64_t> words[2 * kClusterSize];
+	};
+	static_assert(sizeof(Cluster) == boardlib::kCacheLineSize,
+			"A cluster should be exactly one cache line.");
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+			"The table relies on lock free 64 bit atomics.");
+
+private:
+	Cluster* clusters_;
+	std::size_t cluster_count_;
+	std::atomic<unsigned> generation_;
+
+	Cluster& cluster_of(const ZobristKey key) const{
+		return clusters_[key & (cluster_count_ - 1)];
+	}
+
+public:
+	/*
+	 * Create a table of size_in_bytes, rounded down to a power of two
+	 * number of clusters (at least one), cleared by the given number of
+	 * threads.
+	 */
+	explicit TranspositionTable(const std::size_t size_in_bytes, const unsigned threads = 1);
+	~TranspositionTable();
+
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+	/*
+	 * Reallocate the table at a new size and clear it.  Tables of a huge
+	 * page or more are aligned to huge pages, and the kernel is asked to
+	 * back them with huge pages where it supports that.  If the new table
+	 * can't be allocated, the old one is kept as it was.  No search may be
+	 * running.
+	 */
+	void resize(const std::size_t size_in_bytes, const unsigned threads = 1);
+
+	/*
+	 * Empty the table, splitting the work between threads.  No search may
+	 * be running.
+	 */
+	void clear(const unsigned threads = 1);
+
+	/*
+	 * Start a new generation, so that entries from earlier searches are
+	 * replaced first.
+	 */
+	void new_search();
+
+	/*
+	 * Look key up, and if it is found fill in entry and return true.
+	 */
+	bool probe(const ZobristKey key, TableEntry& entry) const;
+
+	/*
+	 * Store the result of a search of the position with key.  A move of
+	 * kNoMove keeps the move already stored for the same key.
+	 */
+	void store(const ZobristKey key, const Move& move, const int score, const int depth,
+			const Bound bound);
+
+	/*
+	 * Prefetch the cluster of key.  The hook form can be passed to
+	 * BoardState::set_prefetch_hook with the table as context.
+	 */
+	void prefetch(const ZobristKey key) const{
+		__builtin_prefetch(&cluster_of(key));
+	}
+	static void prefetch_hook(const void* context, const ZobristKey key);
+
+	/*
+	 * Get the permille of entries written in the current generation, from
+	 * a sample of the first clusters, as UCI's hashfull.
+	 */
+	int get_hashfull() const;
+
+	std::size_t get_size_in_bytes() const;
+};
+
+/*
+ * Static exchange evaluation: the material the side to move gains by
+ * playing move, a capture or promotion, if both sides then keep
+ * recapturing on its destination with their least valuable attacker for
+ * as long as it pays.  Pins are ignored.
+ */
+int see(const BoardState& state, const Move& move);
+
+/*
+ * The selectivity of search, which can be changed between searches for
+ * tuning.  Switches are 1 for on and 0 for off.  Depths are in plies and
+ * margins in centipawns.
+ *
+ *   Aspiration windows: from depth aspiration_min_depth on, search the
+ *   root with a window of aspiration_window around the last score, and
+ *   if the score falls outside, widen the window on that side and search
+ *   again, growing the widening by aspiration_growth percent each time.
+ *
+ *   Null move pruning: give the opponent a free move, and cut off if a
+ *   search reduced by null_move_reduction + depth / null_move_depth_divisor
+ *   + (eval - beta) / null_move_eval_divisor (at most 3 more) still fails
+ *   high.  It is off if the side to move has no pieces, and the cutoff is
+ *   verified by a reduced search without null moves if both sides have at
+ *   most null_move_verify_material of pieces between them, where zugzwang
+ *   and tactics that passing hides are likely.
+ *
+ *   Late move reductions: quiet moves from the lmr_min_moves-th on at
+ *   depth lmr_min_depth or more are searched to a depth reduced by
+ *   (lmr_base + log(depth) * log(index) * 100 / lmr_divisor) / 100 plies,
+ *   and again to full depth if they beat alpha.
+ *
+ *   Null move and reverse futility pruning are only done at nodes off
+ *   the principal variation, those searched with a null window.
+ *
+ *   Reverse futility pruning: return the static evaluation at depth
+ *   reverse_futility_max_depth or less if it beats beta by
+ *   reverse_futility_margin per ply.
+ *
+ *   Futility pruning: skip quiet moves at depth futility_max_depth or less
+ *   if the static evaluation is futility_margin per ply below alpha.
+ *
+ *   Late move pruning: skip quiet moves at depth
+ *   late_move_pruning_max_depth or less once late_move_pruning_base +
+ *   depth * depth moves have been searched.
+ */
+struct SearchParameters{
+	int aspiration_min_depth = 5;
+	int aspiration_window = 25;
+	int aspiration_growth = 50;
+	int null_move = 1;
+	int null_move_min_depth = 3;
+	int null_move_reduction = 3;
+	int null_move_depth_divisor = 4;
+	int null_move_eval_divisor = 200;
+	int null_move_verify_material = 2000;
+	int late_move_reductions = 1;
+	int lmr_min_depth = 3;
+	int lmr_min_moves = 3;
+	int lmr_base = 75;
+	int lmr_divisor = 225;
+	int reverse_futility = 1;
+	int reverse_futility_max_depth = 6;
+	int reverse_futility_margin = 100;
+	int futility = 1;
+	int futility_max_depth = 3;
+	int futility_margin = 120;
+	int late_move_pruning = 1;
+	int late_move_pruning_max_depth = 4;
+	int late_move_pruning_base = 3;
+};
+
+/*
+ * A parameter of SearchParameters by name, for front ends, with its range.
+ * Names are in the style of UCI options.
+ */
+struct ParameterInfo{
+	const char* name;
+	int SearchParameters::* value;
+	int min;
+	int max;
+};
+
+/*
+ * Get every parameter of SearchParameters.
+ */
+const std::vector<ParameterInfo>& get_parameter_info();
+
+/*
+ * What to stop a search at.  Zero means no limit.  The first iteration is
+ * always completed, so that there is a move to play.
+ *
+ * time, increment and moves_to_go are the clock of the side to move, for
+ * the TimeManager to budget, and move_time a fixed time for this move.
+ * move_overhead is kept in hand on every move for the time lost outside
+ * of search, in communication and by the interface.
+ *
+ * excluded_moves are root moves not to search, so that a line after the
+ * best can be found by hand; at least one legal move must be left.
+ */
+struct SearchLimits{
+	int depth = 0;
+	std::uint64_t nodes = 0;
+	std::chrono::milliseconds time = std::chrono::milliseconds(0);
+	std::chrono::milliseconds increment = std::chrono::milliseconds(0);
+	int moves_to_go = 0;
+	std::chrono::milliseconds move_time = std::chrono::milliseconds(0);
+	std::chrono::milliseconds move_overhead = std::chrono::milliseconds(30);
+	std::vector<Move> excluded_moves;
+};
+
+/*
+ * Decides how long iterative deepening goes on for under a clock.
+ *
+ * The clock gives a soft limit, the time to spend on a typical move, and
+ * a hard limit, past which the search is aborted.  With moves_to_go the
+ * time left is shared between that many moves, else between a fixed
+ * number, and most of the increment is added on top.
+ *
+ * After each iteration the soft limit is scaled: up when the best move
+ * has changed recently or the score has dropped, and down when the best
+ * move has held for a while.  Another iteration is started only if the
+ * soft limit has not passed and the iteration is predicted to finish
+ * before the hard limit and not far past the soft one, its time being
+ * estimated from the nodes of the last iteration, the branching factor
+ * between the last two, and the nodes per second so far.
+ *
+ * Elapsed times are passed in rather than read from a clock, so that the
+ * decisions can be replayed.
+ */
+class TimeManager{
+public:
+	typedef std::chrono::duration<double, std::milli> Duration;
+
+private:
+	bool enabled_;
+	bool fixed_;
+	Duration base_soft_limit_;
+	Duration hard_limit_;
+	double scale_;
+
+	/*
+	 * The history of the iterations so far.  best_move_changes_ decays by
+	 * half every iteration, so that it weighs recent changes most.
+	 */
+	int iterations_;
+	Move best_move_;
+	int score_;
+	double best_move_changes_;
+	int stable_iterations_;
+	std::uint64_t nodes_;
+	std::uint64_t last_iteration_nodes_;
+	double branching_factor_;
+	Duration elapsed_;
+
+public:
+	explicit TimeManager(const SearchLimits& limits);
+
+	/*
+	 * Whether limits has a clock or move time at all.  If not, nothing is
+	 * ever stopped for time.
+	 */
+	bool is_enabled() const;
+
+	/*
+	 * The soft limit, as scaled after the last iteration, and the hard
+	 * limit.
+	 */
+	Duration get_soft_limit() const;
+	Duration get_hard_limit() const;
+
+	/*
+	 * Record a completed iteration: its best move and score, the nodes
+	 * searched since the search started and the time elapsed.
+	 */
+	void update(const Move& best_move, int score, std::uint64_t nodes, Duration elapsed);
+
+	/*
+	 * The predicted time of the next iteration, zero before two iterations
+	 * have been recorded.
+	 */
+	Duration predict_next_iteration() const;
+
+	/*
+	 * Whether to stop after the last iteration recorded.
+	 */
+	bool should_stop() const;
+};
+
+/*
+ * A root move, the first of pv, with its score.
+ */
+struct RootMove{
+	int score = 0;
+	std::vector<Move> pv;
+};
+
+/*
+ * The result of one iteration of iterative deepening.  Nodes count every
+ * node visited since the search started, so the final report holds the
+ * totals.
+ */
+struct SearchInfo{
+	int depth = 0;
+	int score = 0;
+	std::uint64_t nodes = 0;
+	std::uint64_t nps = 0;
+	std::chrono::milliseconds time = std::chrono::milliseconds(0);
+	std::vector<Move> pv;
+
+	/*
+	 * Transposition table use: the hashfull permille and the share of
+	 * this search's probes that hit.
+	 */
+	int hashfull = 0;
+	double table_hit_rate = 0;
+
+	/*
+	 * The nodes visited in quiescence search, and the nodes visited at
+	 * each ply, of both kinds, up to the deepest ply reached.
+	 */
+	std::uint64_t quiescence_nodes = 0;
+	std::vector<std::uint64_t> ply_nodes;
+
+	/*
+	 * The share of beta cutoffs made by the first move searched, which
+	 * measures move ordering.
+	 */
+	double first_move_cutoff_rate = 0;
+
+	/*
+	 * The number of full window searches of moves after the first, when
+	 * their null window search failed high, and the number of root
+	 * searches that fell outside their aspiration window on each side.
+	 */
+	std::uint64_t researches = 0;
+	int aspiration_fail_highs = 0;
+	int aspiration_fail_lows = 0;
+
+	/*
+	 * The best root moves found, best first, as many as the MultiPV
+	 * setting asks for and there are legal moves.  The first is score and
+	 * pv.
+	 */
+	std::vector<RootMove> root_moves;
+};
+
+/*
+ * A triangular table of principal variations.  The row of each ply holds
+ * the best line found from the node at that ply, and a new best move at a
+ * ply is prefixed to the line of the ply below it.
+ */
+class PvTable{
+private:
+	Move moves_[kMaxPly][kMaxPly];
+	int lengths_[kMaxPly];
+
+public:
+	PvTable();
+
+	/*
+	 * Empty the line at ply.
+	 */
+	void clear(const int ply){
+		lengths_[ply] = 0;
+	}
+
+	/*
+	 * Make the line at ply move followed by the line at ply + 1.
+	 */
+	void update(const int ply, const Move& move);
+
+	/*
+	 * Get the line at ply.
+	 */
+	std::vector<Move> line(const int ply) const;
+
+	/*
+	 * Make the line at ply the given one, as line(ply) would return it.
+	 */
+	void set_line(const int ply, const std::vector<Move>& line);
+};
+
+/*
+ * A move as the move ordering heuristics see it: the piece that moved and
+ * its destination.  piece is NO_PIECE where there is no move, before the
+ * root.
+ */
+struct PieceTo{
+	Piece piece = Piece::NO_PIECE;
+	SquareIndex square = 0;
+};
+
+/*
+ * A node whose younger brothers, the moves after the first, are searched
+ * in parallel by YBWC (young brothers wait).  The thread that found the
+ * node owns it and waits in it until every move is done.  Each move is a
+ * SplitTask in the owner's work queue, which any idle thread can steal.
+ * Thieves search from their own copy of snapshot, with the window as it
+ * stands when they start, and merge their results under mutex.
+ *
+ * A fail high sets cutoff, and everything still being searched below
+ * the node, at any depth, is abandoned.
+ */
+struct SplitPoint{
+	const SplitPoint* parent = nullptr;
+	std::unique_ptr<const BoardState> snapshot;
+	int depth = 0;
+	int ply = 0;
+	int beta = 0;
+	std::atomic<int> alpha;
+	std::atomic<bool> cutoff;
+	std::atomic<int> pending;
+
+	/*
+	 * The best result so far, and its line from this node, under mutex.
+	 */
+	std::mutex mutex;
+	int best = -kInfinity;
+	Move best_move;
+	std::vector<Move> pv;
+
+	/*
+	 * The moves one and two plies before the node, for the heuristics.
+	 */
+	PieceTo previous[2];
+	bool in_check = false;
+
+	SplitPoint() : alpha(0), cutoff(false), pending(0){}
+
+	/*
+	 * Return true if this node or one above it has failed high.
+	 */
+	bool is_cut_off() const{
+		for(const SplitPoint* node = this; node != nullptr; node = node->parent){
+			if(node->cutoff.load(std::memory_order_relaxed)){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+	 * Return true if this node is ancestor or is one of its descendants.
+	 */
+	bool is_within(const SplitPoint* ancestor) const{
+		for(const SplitPoint* node = this; node != nullptr; node = node->parent){
+			if(node == ancestor){
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+struct SplitTask{
+	SplitPoint* split_point;
+	Move move;
+	std::size_t index;
+};
+
+/*
+ * The work-stealing scheduler of YBWC.  Each thread has a deque of tasks.
+ * It pushes the moves of its split points onto the back and takes its own
+ * tasks from the back, while thieves steal from the front, where the
+ * oldest and so largest subtrees are.  Deques are short and touched once
+ * per split subtree, so each has a plain lock.
+ */
+class WorkPool{
+private:
+	struct alignas(boardlib::kCacheLineSize) Queue{
+		std::mutex mutex;
+		std::deque<SplitTask> tasks;
+	};
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::atomic<unsigned> idle_;
+
+public:
+	explicit WorkPool(const unsigned threads);
+
+	void push(const unsigned thread, const SplitTask& task);
+
+	/*
+	 * Take a task for thread, its own newest one if that is below within
+	 * or else the oldest one below within of another thread.  A within of
+	 * null takes any task.  Return false if there is none.
+	 */
+	bool take(const unsigned thread, SplitTask& task, const SplitPoint* within);
+
+	/*
+	 * The number of threads waiting for work, which splitting is only
+	 * worth it if there are.
+	 */
+	unsigned get_idle() const{
+		return idle_.load(std::memory_order_relaxed);
+	}
+	void add_idle(const int count){
+		idle_.fetch_add(count, std::memory_order_relaxed);
+	}
+};
+
+/*
+ * An iterative deepening alpha-beta searcher.  Each iteration is a
+ * fail-soft principal variation search to the next depth, in an
+ * aspiration window around the last score.  The first move of each node
+ * is searched with the full window, and the rest with a null window to
+ * prove that they are worse, and again with the full window if not.
+ *
+ * Moves are searched in the order of the principal variation of the last
+ * iteration, then the transposition table move, then captures by most
+ * valuable victim, least valuable attacker, then killers and the
+ * countermove, then quiet moves by history.
+ *
+ * With MultiPV, each iteration searches the root once per line, leaving
+ * out the root moves of the lines before, and each line keeps its own
+ * principal variation and aspiration window from the last iteration.
+ * The transposition table carries what one line learns to the next.
+ *
+ * A Searcher keeps its own evaluation caches and move ordering
+ * heuristics, so one is needed per thread, but the transposition table
+ * may be shared.  Searchers other than thread 0 are helpers for Lazy SMP;
+ * see ParallelSearcher.
+ */
+class Searcher{
+public:
+	typedef std::function<void(const SearchInfo&)> InfoCallback;
+
+private:
+	evallib::Evaluator evaluator_;
+	TranspositionTable& table_;
+	PvTable pv_table_;
+	InfoCallback info_callback_;
+
+	/*
+	 * Move ordering heuristics, learned from the quiet moves that cause
+	 * cutoffs and kept between searches.
+	 *
+	 *   killers_       two such moves per ply, newest first.
+	 *   history_       a score per [white][from][to].
+	 *   countermoves_  the reply to the previous move, by its [piece][to].
+	 *   continuation_  a score per [piece][to] of the moves one and two
+	 *                  plies before and [piece][to] of the move.
+	 *
+	 * Scores move towards +-kHistoryMax with each update, slower the
+	 * closer they are, so they keep track of recent results.
+	 */
+	struct alignas(boardlib::kCacheLineSize) ContinuationHistory{
+		std::int16_t scores[boardlib::kPieceEncodings][boardlib::kSquaresPerBoard]
+				[boardlib::kPieceEncodings][boardlib::kSquaresPerBoard];
+	};
+	alignas(boardlib::kCacheLineSize) Move killers_[kMaxPly][2];
+	alignas(boardlib::kCacheLineSize) std::int16_t history_[2][boardlib::kSquaresPerBoard]
+			[boardlib::kSquaresPerBoard];
+	alignas(boardlib::kCacheLineSize) Move countermoves_[boardlib::kPieceEncodings]
+			[boardlib::kSquaresPerBoard];
+	std::unique_ptr<ContinuationHistory> continuation_;
+
+	/*
+	 * The move made at each ply of the current line.
+	 */
+	PieceTo stack_[kMaxPly];
+
+	/*
+	 * The index of this Searcher's thread, and the flag that stops it from
+	 * another thread, if any.
+	 */
+	unsigned thread_index_;
+	const std::atomic<bool>* stop_flag_;
+
+	/*
+	 * The YBWC scheduler, if splitting is on, and the innermost split point
+	 * that this Searcher is working below.
+	 */
+	WorkPool* work_pool_;
+	const SplitPoint* split_point_;
+
+	/*
+	 * The state of the current search.  root_depth_ is the depth of the
+	 * current iteration, and follow_pv_ is true while search is on the
+	 * path of the previous principal variation.  nodes_ is only written by
+	 * the searching thread but may be read by others.  deadline_ is the
+	 * hard time limit, if limits_ has one, and the clock is read for it
+	 * once nodes_ reaches next_clock_check_.
+	 */
+	SearchLimits limits_;
+	bool has_deadline_;
+	std::chrono::steady_clock::time_point deadline_;
+	std::uint64_t next_clock_check_;
+	std::vector<Move> previous_pv_;
+	int root_depth_;
+	bool follow_pv_;
+	bool aborted_;
+	std::atomic<std::uint64_t> nodes_;
+	std::uint64_t table_probes_;
+	std::uint64_t table_hits_;
+	std::uint64_t quiescence_nodes_;
+	std::uint64_t ply_nodes_[kMaxPly];
+	std::uint64_t cutoffs_;
+	std::uint64_t first_move_cutoffs_;
+
+	/*
+	 * The selectivity, with the late move reductions it implies by
+	 * [depth][index], and the first ply null moves are allowed at, which
+	 * verification searches raise.
+	 */
+	SearchParameters parameters_;
+	std::uint8_t reductions_[kMaxPly][boardlib::kMaxMoves];
+	int null_move_min_ply_;
+
+	/*
+	 * Counts for SearchInfo::researches and the aspiration failures.
+	 */
+	std::uint64_t researches_;
+	int aspiration_fail_highs_;
+	int aspiration_fail_lows_;
+
+	/*
+	 * The number of root moves to find, and the root moves left out of the
+	 * current root search: those of the limits, followed by those earlier
+	 * lines of this iteration have.
+	 */
+	unsigned multi_pv_;
+	std::vector<Move> excluded_root_moves_;
+
+	/*
+	 * Count a node at ply.
+	 */
+	void count_node(const int ply){
+		// Only this thread writes nodes_, so it needs no atomic increment.
+		nodes_.store(get_nodes() + 1, std::memory_order_relaxed);
+		ply_nodes_[ply]++;
+	}
+
+	/*
+	 * Return true if a helper should skip the iteration to depth.
+	 */
+	bool skips_depth(const int depth) const;
+
+	/*
+	 * Order moves for search, best first.
+	 */
+	void order_moves(const BoardState& state, MoveList& moves, const int ply,
+			const Move& table_move);
+
+	/*
+	 * Return the move made plies_ago plies before ply.
+	 */
+	PieceTo previous_move(const int ply, const int plies_ago) const{
+		return ply >= plies_ago?stack_[ply - plies_ago]:PieceTo();
+	}
+
+	/*
+	 * Return the history score of a quiet move of piece at ply.
+	 */
+	int history_score(const BoardState& state, const int ply, const Piece piece,
+			const Move& move) const;
+
+	/*
+	 * Learn from a quiet move at ply that caused a cutoff at depth, after
+	 * the quiet moves in tried failed to.
+	 */
+	void update_heuristics(const BoardState& state, const int ply, const int depth,
+			const Move& move, const Move* tried, const std::size_t tried_count);
+
+	/*
+	 * Search state to depth with the window (alpha, beta), returning a
+	 * score that is exact if it lies inside the window and a bound on the
+	 * side of the window it lies on otherwise.
+	 */
+	int negamax(BoardState& state, const int depth, const int ply, int alpha,
+			const int beta);
+
+	/*
+	 * Search only captures and promotions from state, or every evasion if
+	 * in check, until the position is quiet.  Otherwise as negamax.
+	 */
+	int quiescence(BoardState& state, const int ply, int alpha, const int beta);
+
+	/*
+	 * Search the root to depth in aspiration windows around previous_score,
+	 * widening them until the score falls inside, and return it.
+	 */
+	int search_root(BoardState& state, const int depth, const int previous_score);
+
+	/*
+	 * Search move, the index-th at a node at ply, with a null window
+	 * unless it is the first, reduced if it is late, and return its score.
+	 * The other arguments are as in negamax.
+	 */
+	int search_move(BoardState& state, const Move& move, const std::size_t index,
+			const int depth, const int ply, const int alpha, const int beta,
+			const bool in_check);
+
+	/*
+	 * Return true if move, the index-th at a node at ply, is not worth
+	 * searching by futility or late move pruning.  Checks always are.
+	 */
+	bool is_futile(BoardState& state, const Move& move, const std::size_t index,
+			const int depth, const int ply, const int alpha, const bool in_check,
+			const int static_eval) const;
+
+	/*
+	 * Check the limits, and set aborted_ if they have been reached.
+	 */
+	bool should_abort();
+
+	/*
+	 * Return true if a split point this Searcher is working below has
+	 * failed high, so that the current result is not needed.
+	 */
+	bool is_cut_off() const{
+		return split_point_ != nullptr && split_point_->is_cut_off();
+	}
+
+	/*
+	 * Split the node at ply after its first moves, before moves[first],
+	 * search the rest in parallel, and return the best score.  The other
+	 * arguments are as in negamax, and updated with the results.
+	 */
+	int split(BoardState& state, const MoveList& moves, const std::size_t first,
+			const int depth, const int ply, int& alpha, const int beta, int best,
+			Move& best_move, const bool in_check, const int static_eval);
+
+	/*
+	 * Search a move of a split point and merge the result into it.
+	 */
+	void run_task(const SplitTask& task);
+
+	/*
+	 * Prepare to run tasks of others' searches, as a helper does instead of
+	 * searching itself.
+	 */
+	void start_tasks();
+
+	friend class ParallelSearcher;
+
+public:
+	/*
+	 * Create a Searcher using material_table and table, which must outlive
+	 * it.
+	 */
+	Searcher(const evallib::MaterialTable& material_table, TranspositionTable& table,
+			const std::size_t pawn_table_size = std::size_t(1) << 20);
+
+	/*
+	 * Set the function called with the result of every completed iteration.
+	 */
+	void set_info_callback(InfoCallback callback);
+
+	/*
+	 * Make this Searcher the one for thread index.  Thread 0 starts a new
+	 * transposition table generation with each search.  Helpers don't, and
+	 * skip some iterations, each index according to a different schedule,
+	 * so that the threads spread out over depths instead of all searching
+	 * the same tree.
+	 */
+	void set_thread_index(const unsigned index);
+
+	/*
+	 * Set a flag that stops search once it is true, after the first
+	 * iteration.  It must outlive the searches that use it.
+	 */
+	void set_stop_flag(const std::atomic<bool>* flag);
+
+	/*
+	 * Forget what the move ordering heuristics have learned, as for a new
+	 * game.
+	 */
+	void clear_heuristics();
+
+	/*
+	 * Turn YBWC splitting on, with the scheduler pool, or off, with null.
+	 * The pool must outlive the searches that use it.
+	 */
+	void set_work_pool(WorkPool* pool);
+
+	/*
+	 * Change the selectivity.  No search may be running.
+	 */
+	void set_parameters(const SearchParameters& parameters);
+	const SearchParameters& get_parameters() const;
+
+	/*
+	 * Change the number of root moves searched for, each with its own score
+	 * and principal variation.  No search may be running.
+	 */
+	void set_multi_pv(const unsigned multi_pv);
+	unsigned get_multi_pv() const;
+
+	/*
+	 * Get the number of nodes of the current or last search.  This may be
+	 * called from any thread.
+	 */
+	std::uint64_t get_nodes() const;
+
+	/*
+	 * Search state within limits and return the result of the deepest
+	 * completed iteration.  Moves are made and unmade on state, which is
+	 * as it was when this returns.  The pv is empty if state has no legal
+	 * moves.
+	 */
+	SearchInfo search(BoardState& state, const SearchLimits& limits);
+};
+
+/*
+ * How ParallelSearcher divides the work.
+ *
+ *   LAZY_SMP  every thread searches the whole tree, sharing results
+ *             through the transposition table.
+ *   YBWC      thread 0 searches the tree, and nodes are split among idle
+ *             threads once their first move has been searched.
+ */
+enum class ParallelMode : unsigned char {
+	LAZY_SMP,
+	YBWC
+};
+
+/*
+ * A pool of persistent threads searching in parallel, by either mode.  The
+ * calling thread searches as thread 0 within the limits.
+ *
+ * In LAZY_SMP mode each helper has its own Searcher and clone of the root,
+ * and searches without limits until thread 0 is done.  What the helpers
+ * find reaches thread 0 through the table.  The move played is chosen by a
+ * vote among the threads, where each thread votes for its best move with a
+ * weight that grows with its depth and with how its score compares to the
+ * others, and the deepest thread for the winning move reports the result.
+ *
+ * In YBWC mode the helpers wait for split point tasks instead, and only
+ * thread 0's result counts.  So it does with MultiPV in either mode.
+ */
+class ParallelSearcher{
+private:
+	struct Helper{
+		std::unique_ptr<Searcher> searcher;
+		std::unique_ptr<BoardState> root;
+		SearchLimits limits;
+		SearchInfo result;
+		std::thread thread;
+	};
+
+	const evallib::MaterialTable& material_table_;
+	TranspositionTable& table_;
+	const std::size_t pawn_table_size_;
+	std::unique_ptr<Searcher> main_;
+	std::vector<std::unique_ptr<Helper>> helpers_;
+	Searcher::InfoCallback info_callback_;
+	ParallelMode mode_;
+	SearchParameters parameters_;
+	unsigned multi_pv_;
+	std::unique_ptr<WorkPool> work_pool_;
+
+	/*
+	 * Helpers wait on condition_ for search_id_ to change, search, and
+	 * decrement running_ when done.  stop_ is shared by every Searcher.
+	 */
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::uint64_t search_id_;
+	unsigned running_;
+	bool quit_;
+	std::atomic<bool> stop_;
+
+	/*
+	 * The body of a helper thread, which starts out having seen search
+	 * last_search_id.
+	 */
+	void run_helper(Helper& helper, std::uint64_t last_search_id);
+	void start_helpers(const unsigned count);
+	void stop_helpers();
+
+public:
+	/*
+	 * Create a ParallelSearcher with threads threads in total, including
+	 * the calling one.  material_table and table must outlive it.
+	 */
+	ParallelSearcher(const evallib::MaterialTable& material_table, TranspositionTable& table,
+			const unsigned threads = 1,
+			const std::size_t pawn_table_size = std::size_t(1) << 20);
+	~ParallelSearcher();
+
+	/*
+	 * Change the number of threads.  No search may be running.
+	 */
+	void set_threads(const unsigned threads);
+	unsigned get_threads() const;
+
+	/*
+	 * Forget what every thread's move ordering heuristics have learned.
+	 * No search may be running.
+	 */
+	void clear_heuristics();
+
+	/*
+	 * Change the mode.  No search may be running.
+	 */
+	void set_mode(const ParallelMode mode);
+	ParallelMode get_mode() const;
+
+	/*
+	 * Change the selectivity of every thread.  No search may be running.
+	 */
+	void set_parameters(const SearchParameters& parameters);
+	const SearchParameters& get_parameters() const;
+
+	/*
+	 * Change the number of root moves thread 0 searches for.  Helpers
+	 * search for one.  No search may be running.
+	 */
+	void set_multi_pv(const unsigned multi_pv);
+	unsigned get_multi_pv() const;
+
+	/*
+	 * Set the function called with the result of every iteration thread 0
+	 * completes, with the nodes of all the threads, and once more with the
+	 * result of a helper when the vote picks it.
+	 */
+	void set_info_callback(Searcher::InfoCallback callback);
+
+	/*
+	 * Stop the current search from another thread.
+	 */
+	void stop();
+
+	/*
+	 * Search state within limits, as Searcher::search, with every thread.
+	 */
+	SearchInfo search(BoardState& state, const SearchLimits& limits);
+};
+
+} // namespace searchlib
+#endif /* SRC_SEARCHLIB_H_ */
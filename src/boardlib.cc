@@ -7,6 +7,13 @@
 
 #include <boardlib.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
 namespace boardlib{
 
 
@@ -22,29 +29,6 @@ namespace boardlib{
 //	value_ = value_ ^ rhs.value_;
 //}
 
-SquareIndex BitBoard::greatest_square_index() const{
-	decltype(value_) temp_value = value_;
-	SquareIndex result = 0;
-	while(temp_value >>= 1){
-		result++;
-	}
-	return(result);
-}
-
-BitBoard BitBoard::least_significant_1_bit() const{
-	return BitBoard(value_ & (-value_));
-}
-
-BitBoard BitBoard::pop_least_significant_1_bit(){
-	decltype(value_) temp_value = value_ & (-value_);
-	value_ ^= temp_value;
-	return BitBoard(temp_value);
-}
-
-SquareIndex BitBoard::population_count() const{
-	// TODO: Potentially not portable.
-	return (SquareIndex) __builtin_popcountll(value_);
-}
 
 
 //void BitBoard::step_east(){
@@ -114,69 +98,50 @@ SquareIndex algebraic_to_square_index(const std::string algebraic){
 	return square_index_of(rank_index, file_index);
 }
 
-char piece_to_fen(const Piece piece){
-	switch(piece){
-	case Piece::WHITE_KING:
-		return 'K';
-	case Piece::BLACK_KING:
-		return 'k';
-	case Piece::WHITE_QUEEN:
-		return 'Q';
-	case Piece::BLACK_QUEEN:
-		return 'q';
-	case Piece::WHITE_BISHOP:
-		return 'B';
-	case Piece::BLACK_BISHOP:
-		return 'b';
-	case Piece::WHITE_KNIGHT:
-		return 'N';
-	case Piece::BLACK_KNIGHT:
-		return 'n';
-	case Piece::WHITE_ROOK:
-		return 'R';
-	case Piece::BLACK_ROOK:
-		return 'r';
-	case Piece::WHITE_PAWN:
-		return 'P';
-	case Piece::BLACK_PAWN:
-		return 'p';
-	case Piece::WHITE_EN_PASSANT:
-		return '*';
-	case Piece::BLACK_EN_PASSANT:
-		return '*';
-	case Piece::NO_PIECE:
-		return '-';
-	default:
-		throw "Invalid Piece passed to piece_to_fen.";
+Move uci_to_move(const std::string& uci){
+	if(uci.size() < 4 || uci.size() > 5){
+		throw "Improperly formated string passed to uci_to_move.";
+	}
+	const SquareIndex from_square = algebraic_to_square_index(uci.substr(0, 2));
+	const SquareIndex to_square = algebraic_to_square_index(uci.substr(2, 2));
+	if(uci.size() == 4){
+		return Move(from_square, to_square);
+	}
+	// Promotions to the eighth rank are white's, to the first black's.
+	const char promotion_char = rank_index_of(to_square) == kRanksPerBoard - 1?
+			toupper(uci[4]):tolower(uci[4]);
+	return Move(from_square, to_square, fen_to_piece(promotion_char));
+}
+
+std::string move_to_uci(const Move& move){
+	std::string result = square_index_to_algebraic(move.from_square) +
+			square_index_to_algebraic(move.to_square);
+	if(move.promotion != Piece::NO_PIECE){
+		result += tolower(piece_to_fen(move.promotion));
 	}
+	return result;
+}
+
+bool MoveList::contains(const Move& move) const{
+	return std::find(begin(), end(), move) != end();
 }
 
 Piece fen_to_piece(const char piece_char){
-	switch(piece_char){
-	case 'K':
-		return Piece::WHITE_KING;
+	// The case of the char gives the color and the letter gives the kind.
+	const Color color = isupper(piece_char)?Color::WHITE:Color::BLACK;
+	switch(tolower(piece_char)){
 	case 'k':
-		return Piece::BLACK_KING;
-	case 'Q':
-		return Piece::WHITE_QUEEN;
+		return make_piece(color, PieceKind::KING);
 	case 'q':
-		return Piece::BLACK_QUEEN;
-	case 'B':
-		return Piece::WHITE_BISHOP;
+		return make_piece(color, PieceKind::QUEEN);
 	case 'b':
-		return Piece::BLACK_BISHOP;
-	case 'N':
-		return Piece::WHITE_KNIGHT;
+		return make_piece(color, PieceKind::BISHOP);
 	case 'n':
-		return Piece::BLACK_KNIGHT;
-	case 'R':
-		return Piece::WHITE_ROOK;
+		return make_piece(color, PieceKind::KNIGHT);
 	case 'r':
-		return Piece::BLACK_ROOK;
-	case 'P':
-		return Piece::WHITE_PAWN;
+		return make_piece(color, PieceKind::ROOK);
 	case 'p':
-		return Piece::BLACK_PAWN;
+		return make_piece(color, PieceKind::PAWN);
 	case '-':
 		return Piece::NO_PIECE;
 	default:
@@ -184,160 +149,6 @@ Piece fen_to_piece(const char piece_char){
 	}
 }
 
-int piece_index_of(Piece piece){
-	switch(piece){
-		case Piece::WHITE_KING:
-			return 0;
-		case Piece::BLACK_KING:
-			return 1;
-		case Piece::WHITE_QUEEN:
-			return 2;
-		case Piece::BLACK_QUEEN:
-			return 3;
-		case Piece::WHITE_BISHOP:
-			return 4;
-		case Piece::BLACK_BISHOP:
-			return 5;
-		case Piece::WHITE_KNIGHT:
-			return 6;
-		case Piece::BLACK_KNIGHT:
-			return 7;
-		case Piece::WHITE_ROOK:
-			return 8;
-		case Piece::BLACK_ROOK:
-			return 9;
-		case Piece::WHITE_PAWN:
-			return 10;
-		case Piece::BLACK_PAWN:
-			return 11;
-		case Piece::WHITE_EN_PASSANT:
-			return 12;
-		case Piece::BLACK_EN_PASSANT:
-			return 13;
-		case Piece::NO_PIECE:
-			return 14;
-		default:
-			return -1;
-	};
-}
-
-PieceKind kind_of(const Piece piece){
-	switch(piece){
-	case Piece::NO_PIECE:
-		return PieceKind::NO_PIECE;
-	case Piece::WHITE_KING:
-		return PieceKind::KING;
-	case Piece::BLACK_KING:
-		return PieceKind::KING;
-	case Piece::WHITE_QUEEN:
-		return PieceKind::QUEEN;
-	case Piece::BLACK_QUEEN:
-		return PieceKind::QUEEN;
-	case Piece::WHITE_BISHOP:
-		return PieceKind::BISHOP;
-	case Piece::BLACK_BISHOP:
-		return PieceKind::BISHOP;
-	case Piece::WHITE_KNIGHT:
-		return PieceKind::KNIGHT;
-	case Piece::BLACK_KNIGHT:
-		return PieceKind::KNIGHT;
-	case Piece::WHITE_ROOK:
-		return PieceKind::ROOK;
-	case Piece::BLACK_ROOK:
-		return PieceKind::ROOK;
-	case Piece::WHITE_PAWN:
-		return PieceKind::PAWN;
-	case Piece::BLACK_PAWN:
-		return PieceKind::PAWN;
-	case Piece::WHITE_EN_PASSANT:
-		return PieceKind::EN_PASSANT;
-	case Piece::BLACK_EN_PASSANT:
-		return PieceKind::EN_PASSANT;
-	default:
-		/*
-		 * This default case will never be reached, since all possibilities
-		 * are enumerated above, but CDT was complaining.
-		 */
-		return PieceKind::NO_PIECE;
-	}
-}
-
-bool is_diagonal_slider(const PieceKind kind){
-	switch(kind){
-	case PieceKind::QUEEN:
-		return true;
-	case PieceKind::BISHOP:
-		return true;
-	default:
-		return false;
-	}
-}
-
-bool is_non_diagonal_slider(const PieceKind kind){
-	switch(kind){
-	case PieceKind::QUEEN:
-		return true;
-	case PieceKind::ROOK:
-		return true;
-	default:
-		return false;
-	}
-}
-
-bool is_slider(const PieceKind kind){
-	switch(kind){
-	case PieceKind::QUEEN:
-		return true;
-	case PieceKind::ROOK:
-		return true;
-	case PieceKind::BISHOP:
-		return true;
-	default:
-		return false;
-	}
-}
-
-Color color_of(const Piece piece){
-	switch(piece){
-	case Piece::NO_PIECE:
-		return Color::NO_COLOR;
-	case Piece::WHITE_KING:
-		return Color::WHITE;
-	case Piece::BLACK_KING:
-		return Color::BLACK;
-	case Piece::WHITE_QUEEN:
-		return Color::WHITE;
-	case Piece::BLACK_QUEEN:
-		return Color::BLACK;
-	case Piece::WHITE_BISHOP:
-		return Color::WHITE;
-	case Piece::BLACK_BISHOP:
-		return Color::BLACK;
-	case Piece::WHITE_KNIGHT:
-		return Color::WHITE;
-	case Piece::BLACK_KNIGHT:
-		return Color::BLACK;
-	case Piece::WHITE_ROOK:
-		return Color::WHITE;
-	case Piece::BLACK_ROOK:
-		return Color::BLACK;
-	case Piece::WHITE_PAWN:
-		return Color::WHITE;
-	case Piece::BLACK_PAWN:
-		return Color::BLACK;
-	case Piece::WHITE_EN_PASSANT:
-		return Color::WHITE;
-	case Piece::BLACK_EN_PASSANT:
-		return Color::BLACK;
-	default:
-		/*
-		 * This default case will never be reached, since all possibilities
-		 * are enumerated above, but CDT was complaining.
-		 */
-		return Color::NO_COLOR;
-	}
-}
-
 /*
  * Represent the minimum information needed to define the state of the board.
  */
@@ -355,8 +166,6 @@ BitBoard& BoardStateCore::get_piece_kind_bit_board(const PieceKind kind){
 		return rooks_;
 	case PieceKind::PAWN:
 		return pawns_;
-	case PieceKind::EN_PASSANT:
-		return en_passant_;
 	default:
 		throw "Invalid PieceKind passed to get_piece_kind_bit_board.";
 	}
@@ -405,7 +214,7 @@ BoardStateCore::BoardStateCore(){
 	pawns_ = kEmpty;
 	white_ = kEmpty;
 	black_ = kEmpty;
-	en_passant_ = kNoEnPassant;
+	en_passant_square_ = kNoEnPassant;
 	whites_turn_ = false;
 	white_castle_king_ = false;
 	white_castle_queen_ = false;
@@ -417,20 +226,51 @@ BoardStateCore::BoardStateCore(){
 bool BoardStateCore::operator==(const BoardStateCore& rhs) const{
 	return kings_==rhs.kings_ && queens_==rhs.queens_ && bishops_==rhs.bishops_ &&
 			knights_==rhs.knights_ && rooks_==rhs.rooks_ && pawns_==rhs.pawns_ &&
-			white_==rhs.white_ && black_==rhs.black_ && en_passant_==rhs.en_passant_ &&
+			white_==rhs.white_ && black_==rhs.black_ &&
+			en_passant_square_==rhs.en_passant_square_ &&
 			whites_turn_==rhs.whites_turn_ && white_castle_king_==rhs.white_castle_king_
 			&& white_castle_queen_==rhs.white_castle_queen_ &&
 			black_castle_king_==rhs.black_castle_king_ &&
 			black_castle_queen_==rhs.black_castle_queen_ && valid_==rhs.valid_;
 }
 
-RecordEntry::RecordEntry(const ZobristKey hash, const BoardStateCore state){
-	hash_ = hash;
-	state_ = state;
+bool MoveTables::operator==(const MoveTables& rhs) const{
+	return move_targets==rhs.move_targets && move_origins==rhs.move_origins;
+}
+
+RecordSegment::RecordSegment(std::shared_ptr<const RecordSegment> parent,
+		const std::size_t parent_length, std::vector<ZobristKey>&& keys,
+		std::vector<BoardStateCore>&& cores) :
+		parent_(std::move(parent)), parent_length_(parent_length),
+		keys_(std::move(keys)), cores_(std::move(cores)){
 }
 
-bool RecordEntry::operator==(const RecordEntry& rhs) const{
-	return hash_==rhs.hash_ && state_==rhs.state_;
+const RecordSegment& RecordSegment::segment_of(const std::size_t index) const{
+	// Walk back to the segment that holds index.  Iterate rather than recurse,
+	// since chains may get long in long games.
+	const RecordSegment* segment = this;
+	while(index < segment->parent_length_){
+		segment = segment->parent_.get();
+	}
+	return *segment;
+}
+
+ZobristKey RecordSegment::key_at(const std::size_t index) const{
+	const RecordSegment& segment = segment_of(index);
+	return segment.keys_[index - segment.parent_length_];
+}
+
+const BoardStateCore& RecordSegment::core_at(const std::size_t index) const{
+	const RecordSegment& segment = segment_of(index);
+	return segment.cores_[index - segment.parent_length_];
+}
+
+std::size_t RecordSegment::get_parent_length() const{
+	return parent_length_;
+}
+
+const std::shared_ptr<const RecordSegment>& RecordSegment::get_parent() const{
+	return parent_;
 }
 
 bool Move::operator==(const Move& rhs) const{
@@ -449,8 +289,6 @@ bool MoveRecord::operator==(const MoveRecord& rhs) const{
 			lost_black_castle_queen==rhs.lost_black_castle_queen &&
 			en_passant_square_before==rhs.en_passant_square_before &&
 			en_passant_square_after==rhs.en_passant_square_after &&
-			en_passant_piece_before==rhs.en_passant_piece_before &&
-			en_passant_piece_after==rhs.en_passant_piece_after &&
 			halfmove_clock_before==rhs.halfmove_clock_before &&
 			threefold_repetition_clock_before==rhs.threefold_repetition_clock_before &&
 			halfmove_clock_after==rhs.halfmove_clock_after &&
@@ -508,41 +346,85 @@ std::vector<std::string> BoardState::tokenize_fen_rank(std::string rank_string){
 	return result;
 }
 
+void BoardState::toggle_redundant_data(const Piece piece, const SquareIndex square){
+	const PieceKind kind = kind_of(piece);
+	const BitBoard square_board = BitBoard::from_square_index(square);
+	occupied_ ^= square_board;
+	unoccupied_ ^= square_board;
+	const bool own = (color_of(piece) == Color::WHITE) == core_.whites_turn_;
+	if(own){
+		own_ ^= square_board;
+		own_complement_ ^= square_board;
+	}else{
+		opponent_ ^= square_board;
+	}
+	switch(kind){
+	case PieceKind::KING:
+		// Kings are never captured, so a king being removed is always about
+		// to be placed again, which will set the tracker correctly.
+		if(own){
+			own_king_ ^= square_board;
+			own_king_square_ = square;
+		}else{
+			opponent_king_square_ = square;
+		}
+		break;
+	case PieceKind::QUEEN:
+		(own?own_non_diagonal_sliders_:opponent_non_diagonal_sliders_) ^= square_board;
+		(own?own_diagonal_sliders_:opponent_diagonal_sliders_) ^= square_board;
+		break;
+	case PieceKind::ROOK:
+		(own?own_non_diagonal_sliders_:opponent_non_diagonal_sliders_) ^= square_board;
+		break;
+	case PieceKind::BISHOP:
+		(own?own_diagonal_sliders_:opponent_diagonal_sliders_) ^= square_board;
+		break;
+	case PieceKind::KNIGHT:
+		(own?own_knights_:opponent_knights_) ^= square_board;
+		break;
+	case PieceKind::PAWN:
+		(own?own_pawns_:opponent_pawns_) ^= square_board;
+		break;
+	default:
+		break;
+	}
+}
+
+template<class Policy>
+void BoardState::flip_turn(){
+	core_.whites_turn_ = !core_.whites_turn_;
+	if(!Policy::kRedundantData){
+		return;
+	}
+	std::swap(own_, opponent_);
+	own_complement_ = ~own_;
+	std::swap(own_non_diagonal_sliders_, opponent_non_diagonal_sliders_);
+	std::swap(own_diagonal_sliders_, opponent_diagonal_sliders_);
+	std::swap(own_knights_, opponent_knights_);
+	std::swap(own_pawns_, opponent_pawns_);
+	std::swap(own_king_square_, opponent_king_square_);
+	own_king_ = own_ & core_.kings_;
+}
+
+template<class Policy>
 void BoardState::raw_place_piece(const Piece piece, const SquareIndex square){
 	core_.raw_place_piece(piece, square);
 	piece_map_[square] = piece;
+	if(Policy::kRedundantData){
+		toggle_redundant_data(piece, square);
+	}
 }
 
 void BoardState::raw_unplace_piece(const SquareIndex square){
 	const Piece piece = get_piece_at(square);
 	raw_unplace_piece(piece, square);
 }
+template<class Policy>
 void BoardState::raw_unplace_piece(const Piece piece, const SquareIndex square){
 	core_.raw_unplace_piece(piece, square);
 	piece_map_[square] = Piece::NO_PIECE;
-}
-
-void BoardState::raw_set_en_passant(Piece piece, SquareIndex square){
-	raw_place_piece(piece, square);
-	en_passant_square_ = square;
-}
-
-void BoardState::raw_unset_en_passant(){
-	if(en_passant_square_ != kNoEnPassant){
-		raw_unplace_piece(en_passant_square_);
-		en_passant_square_ = kNoEnPassant;
-	}
-}
-
-void BoardState::raw_change_en_passant(Piece en_passant_piece_before,
-			Piece en_passant_piece_after,
-			SquareIndex en_passant_square_after){
-	if(en_passant_square_ != kNoEnPassant){
-		raw_unplace_piece(en_passant_piece_before, en_passant_square_);
-	}
-	if(en_passant_piece_after != Piece::NO_PIECE){
-		raw_place_piece(en_passant_piece_after, en_passant_square_after);
-		en_passant_square_ = en_passant_square_after;
+	if(Policy::kRedundantData){
+		toggle_redundant_data(piece, square);
 	}
 }
 
@@ -551,6 +433,14 @@ void BoardState::raw_change_en_passant(Piece en_passant_piece_before,
 BoardState::BoardState(BoardState&& rhs) = default;
 
 BoardState::BoardState(){
+	// Enforce the memory budget described in the class comment.  The hot
+	// data must fit in the first two cache lines, and the whole BoardState
+	// in six.
+	static_assert(offsetof(BoardState, piece_map_) == 2*kCacheLineSize,
+			"BoardState hot data must fit in two cache lines.");
+	static_assert(sizeof(BoardState) <= 6*kCacheLineSize,
+			"BoardState must fit in six cache lines.");
+
 	halfmove_clock_ = 0;
 	fullmove_counter_ = 0;
 	halfmove_counter_ = 0;
@@ -561,22 +451,108 @@ BoardState::BoardState(){
 	piece_map_ = {Piece::NO_PIECE};
 
 	hash_ = 0;
+	pawn_key_ = 0;
+	material_key_ = 0;
+	prefetch_hook_ = nullptr;
+	prefetch_context_ = nullptr;
+
+	// The record starts empty, with nothing shared, and holds keys only.
+	shared_record_length_ = 0;
+	verify_repetition_ = false;
+
+	own_king_square_ = 0;
+	opponent_king_square_ = 0;
+
+	// The redundant BitBoards other than these start out empty, like core_.
+	unoccupied_ = kFull;
+	own_complement_ = kFull;
+}
+
+void BoardState::push_record(){
+	const std::size_t capacity = record_keys_.capacity();
+	if(record_keys_.size() == capacity){
+		const std::size_t new_capacity = capacity + std::max(kRecordChunkSize, capacity);
+		record_keys_.reserve(new_capacity);
+		if(verify_repetition_){
+			record_cores_.reserve(new_capacity);
+		}
+	}
+	record_keys_.push_back(hash_);
+	if(verify_repetition_){
+		record_cores_.push_back(core_);
+	}
+}
 
-	// Avoid allocation during game by reserving a bunch of memory now
-	record_.reserve(10000);
+void BoardState::pop_record(){
+	if(!record_keys_.empty()){
+		record_keys_.pop_back();
+		if(verify_repetition_){
+			record_cores_.pop_back();
+		}
+		return;
+	}
+	// The newest entry is shared, so stop seeing it instead.  Drop our
+	// reference to any segment that is no longer visible.
+	shared_record_length_--;
+	while(shared_record_ && shared_record_length_ <= shared_record_->get_parent_length()){
+		shared_record_ = shared_record_->get_parent();
+	}
+}
 
-	// Assume there is no en passant in the empty BoardState
-	en_passant_square_ = kNoEnPassant;
+std::size_t BoardState::get_record_length() const{
+	return shared_record_length_ + record_keys_.size();
+}
+
+ZobristKey BoardState::get_record_key(const std::size_t plies_ago) const{
+	if(plies_ago <= record_keys_.size()){
+		return record_keys_[record_keys_.size() - plies_ago];
+	}
+	return shared_record_->key_at(get_record_length() - plies_ago);
+}
+
+const BoardStateCore& BoardState::get_record_core(const std::size_t plies_ago) const{
+	if(plies_ago <= record_cores_.size()){
+		return record_cores_[record_cores_.size() - plies_ago];
+	}
+	return shared_record_->core_at(get_record_length() - plies_ago);
 }
 
 bool BoardState::operator==(const BoardState& rhs) const{
-	return core_==rhs.core_ && halfmove_clock_==rhs.halfmove_clock_ &&
+	if(!(core_==rhs.core_ && halfmove_clock_==rhs.halfmove_clock_ &&
 			fullmove_counter_==rhs.fullmove_counter_ &&
 			halfmove_counter_==rhs.halfmove_counter_ &&
 			threefold_repetition_clock_==rhs.threefold_repetition_clock_ &&
-			piece_map_==rhs.piece_map_ &&
-			hash_==rhs.hash_ && record_==rhs.record_ &&
-			en_passant_square_==rhs.en_passant_square_;
+			piece_map_==rhs.piece_map_ && hash_==rhs.hash_ &&
+			pawn_key_==rhs.pawn_key_ && material_key_==rhs.material_key_)){
+		return false;
+	}
+	// The redundant data should agree whenever the rest does, so comparing
+	// it catches bugs in keeping it up to date.
+	if(!(occupied_==rhs.occupied_ && unoccupied_==rhs.unoccupied_ &&
+			own_==rhs.own_ && opponent_==rhs.opponent_ &&
+			own_complement_==rhs.own_complement_ && own_king_==rhs.own_king_ &&
+			own_non_diagonal_sliders_==rhs.own_non_diagonal_sliders_ &&
+			opponent_non_diagonal_sliders_==rhs.opponent_non_diagonal_sliders_ &&
+			own_diagonal_sliders_==rhs.own_diagonal_sliders_ &&
+			opponent_diagonal_sliders_==rhs.opponent_diagonal_sliders_ &&
+			own_knights_==rhs.own_knights_ && opponent_knights_==rhs.opponent_knights_ &&
+			own_pawns_==rhs.own_pawns_ && opponent_pawns_==rhs.opponent_pawns_ &&
+			own_king_square_==rhs.own_king_square_ &&
+			opponent_king_square_==rhs.opponent_king_square_)){
+		return false;
+	}
+	// The records are equal if they hold the same entries, regardless of
+	// how each one is split between its shared and private parts.
+	const std::size_t record_length = get_record_length();
+	if(record_length != rhs.get_record_length()){
+		return false;
+	}
+	for(std::size_t plies_ago=1; plies_ago<=record_length; plies_ago++){
+		if(get_record_key(plies_ago) != rhs.get_record_key(plies_ago)){
+			return false;
+		}
+	}
+	return true;
 }
 
 BoardState BoardState::copy() const{
@@ -588,17 +564,300 @@ BoardState BoardState::copy() const{
 	result.threefold_repetition_clock_ = threefold_repetition_clock_;
 	result.piece_map_ = piece_map_;
 	result.hash_ = hash_;
-	result.record_ = record_;
-	result.en_passant_square_ = en_passant_square_;
-	result.move_targets_ = move_targets_;
-	result.move_origins_ = move_origins_;
+	result.pawn_key_ = pawn_key_;
+	result.material_key_ = material_key_;
+	result.prefetch_hook_ = prefetch_hook_;
+	result.prefetch_context_ = prefetch_context_;
+	result.own_king_square_ = own_king_square_;
+	result.opponent_king_square_ = opponent_king_square_;
+	result.occupied_ = occupied_;
+	result.unoccupied_ = unoccupied_;
+	result.own_ = own_;
+	result.opponent_ = opponent_;
+	result.own_complement_ = own_complement_;
+	result.own_king_ = own_king_;
+	result.own_non_diagonal_sliders_ = own_non_diagonal_sliders_;
+	result.opponent_non_diagonal_sliders_ = opponent_non_diagonal_sliders_;
+	result.own_diagonal_sliders_ = own_diagonal_sliders_;
+	result.opponent_diagonal_sliders_ = opponent_diagonal_sliders_;
+	result.own_knights_ = own_knights_;
+	result.opponent_knights_ = opponent_knights_;
+	result.own_pawns_ = own_pawns_;
+	result.opponent_pawns_ = opponent_pawns_;
+	result.shared_record_ = shared_record_;
+	result.shared_record_length_ = shared_record_length_;
+	result.record_keys_ = record_keys_;
+	result.record_cores_ = record_cores_;
+	result.verify_repetition_ = verify_repetition_;
+	if(move_tables_){
+		result.move_tables_.reset(new MoveTables(*move_tables_));
+	}
 	return result;
 }
 
+void BoardState::share_record(){
+	if(record_keys_.empty()){
+		return;
+	}
+	const std::size_t record_size = record_keys_.size();
+	shared_record_ = std::make_shared<const RecordSegment>(shared_record_,
+			shared_record_length_, std::move(record_keys_), std::move(record_cores_));
+	shared_record_length_ += record_size;
+	record_keys_ = std::vector<ZobristKey>();
+	record_cores_ = std::vector<BoardStateCore>();
+}
+
+BoardState BoardState::fork(){
+	share_record();
+	return copy();
+}
+
 ZobristKey BoardState::get_hash() const{
 	return hash_;
 }
 
+ZobristKey BoardState::key_after(const Move& move) const{
+	// The clocks don't enter the key, so a policy that skips them will do.
+	return ZobristHasher::update(hash_, compute_move_record<PerftPolicy>(move));
+}
+
+ZobristKey BoardState::get_pawn_key() const{
+	return pawn_key_;
+}
+
+MaterialKey BoardState::get_material_key() const{
+	return material_key_;
+}
+
+/*
+ * Get the squares attacked by rooks (bishops) on the squares of board, with
+ * the unoccupied squares as given.
+ */
+static BitBoard rook_attacks(const BitBoard board, const BitBoard unoccupied){
+	return BitBoard::slide_east(board, unoccupied).step_east() |
+			BitBoard::slide_north(board, unoccupied).step_north() |
+			BitBoard::slide_west(board, unoccupied).step_west() |
+			BitBoard::slide_south(board, unoccupied).step_south();
+}
+static BitBoard bishop_attacks(const BitBoard board, const BitBoard unoccupied){
+	return BitBoard::slide_northeast(board, unoccupied).step_northeast() |
+			BitBoard::slide_northwest(board, unoccupied).step_northwest() |
+			BitBoard::slide_southwest(board, unoccupied).step_southwest() |
+			BitBoard::slide_southeast(board, unoccupied).step_southeast();
+}
+
+BitBoard BoardState::get_attackers(const SquareIndex square, const bool white,
+		const BitBoard occupied) const{
+	const BitBoard square_board = BitBoard::from_square_index(square);
+	const BitBoard attackers = (white?core_.white_:core_.black_) & occupied;
+	// A pawn attacks square if a pawn of the other color on square would
+	// attack it.
+	const BitBoard pawn_origins = white?
+			square_board.step_southeast() | square_board.step_southwest():
+			square_board.step_northeast() | square_board.step_northwest();
+	return attackers & (
+			(square_board.knight_step() & core_.knights_) |
+			(square_board.king_step() & core_.kings_) |
+			(pawn_origins & core_.pawns_) |
+			(rook_attacks(square_board, ~occupied) & (core_.rooks_ | core_.queens_)) |
+			(bishop_attacks(square_board, ~occupied) & (core_.bishops_ | core_.queens_)));
+}
+
+bool BoardState::is_check() const{
+	const bool white = core_.whites_turn_;
+	const BitBoard king = core_.kings_ & (white?core_.white_:core_.black_);
+	return get_attackers(king.greatest_square_index(), !white, core_.white_ | core_.black_);
+}
+
+void BoardState::generate_moves(MoveList& moves) const{
+	moves.clear();
+	const bool white = core_.whites_turn_;
+	const BitBoard own = white?core_.white_:core_.black_;
+	const BitBoard opponent = white?core_.black_:core_.white_;
+	const BitBoard occupied = own | opponent;
+	const BitBoard unoccupied = ~occupied;
+	const SquareIndex king_square = (core_.kings_ & own).greatest_square_index();
+
+	// A pseudo-legal move is legal if the king isn't attacked afterwards.
+	// Only the occupancy changes matter, with the captured piece removed.
+	auto add_if_legal = [&](const SquareIndex from, const SquareIndex to,
+			const BitBoard captured, const Piece promotion){
+		const BitBoard from_board = BitBoard::from_square_index(from);
+		const BitBoard to_board = BitBoard::from_square_index(to);
+		const BitBoard occupied_after = ((occupied ^ from_board) & ~captured) | to_board;
+		const SquareIndex king_after = from == king_square?to:king_square;
+		if(!(get_attackers(king_after, !white, occupied_after) & ~to_board)){
+			moves.push_back(Move(from, to, promotion));
+		}
+	};
+
+	// Pieces.
+	BitBoard pieces = own & ~core_.pawns_;
+	while(pieces){
+		const BitBoard from_board = pieces.pop_least_significant_1_bit();
+		const SquareIndex from = from_board.greatest_square_index();
+		BitBoard targets;
+		switch(kind_of(piece_map_[from])){
+		case PieceKind::KNIGHT:
+			targets = from_board.knight_step();
+			break;
+		case PieceKind::BISHOP:
+			targets = bishop_attacks(from_board, unoccupied);
+			break;
+		case PieceKind::ROOK:
+			targets = rook_attacks(from_board, unoccupied);
+			break;
+		case PieceKind::QUEEN:
+			targets = bishop_attacks(from_board, unoccupied) | rook_attacks(from_board, unoccupied);
+			break;
+		default:
+			targets = from_board.king_step();
+			break;
+		}
+		targets &= ~own;
+		while(targets){
+			const BitBoard to_board = targets.pop_least_significant_1_bit();
+			add_if_legal(from, to_board.greatest_square_index(), to_board, Piece::NO_PIECE);
+		}
+	}
+
+	// Pawns, with promotions to each piece.
+	const Piece promotions[] = {
+			white?Piece::WHITE_QUEEN:Piece::BLACK_QUEEN,
+			white?Piece::WHITE_ROOK:Piece::BLACK_ROOK,
+			white?Piece::WHITE_BISHOP:Piece::BLACK_BISHOP,
+			white?Piece::WHITE_KNIGHT:Piece::BLACK_KNIGHT};
+	const BitBoard en_passant = core_.en_passant_square_ == kNoEnPassant?kEmpty:
+			BitBoard::from_square_index(core_.en_passant_square_);
+	const BitBoard last_rank = white?kRank8:kRank1;
+	BitBoard pawns = own & core_.pawns_;
+	while(pawns){
+		const BitBoard from_board = pawns.pop_least_significant_1_bit();
+		const SquareIndex from = from_board.greatest_square_index();
+		const BitBoard single = (white?from_board.step_north():from_board.step_south()) & unoccupied;
+		const BitBoard start_rank = white?kRank2:kRank7;
+		const BitBoard double_step = (from_board & start_rank)?
+				(white?single.step_north():single.step_south()) & unoccupied:kEmpty;
+		const BitBoard attacks = white?
+				from_board.step_northeast() | from_board.step_northwest():
+				from_board.step_southeast() | from_board.step_southwest();
+		BitBoard targets = single | double_step | (attacks & (opponent | en_passant));
+		while(targets){
+			const BitBoard to_board = targets.pop_least_significant_1_bit();
+			const SquareIndex to = to_board.greatest_square_index();
+			// An en passant capture takes the pawn beside the moving one.
+			const BitBoard captured = to_board & en_passant?
+					(white?to_board.step_south():to_board.step_north()):to_board;
+			if(to_board & last_rank){
+				for(const Piece promotion : promotions){
+					add_if_legal(from, to, captured, promotion);
+				}
+			}else{
+				add_if_legal(from, to, captured, Piece::NO_PIECE);
+			}
+		}
+	}
+
+	// Castling, through and onto unattacked squares, and not out of check.
+	const bool can_castle_king = white?core_.white_castle_king_:core_.black_castle_king_;
+	const bool can_castle_queen = white?core_.white_castle_queen_:core_.black_castle_queen_;
+	if((can_castle_king || can_castle_queen) &&
+			!get_attackers(king_square, !white, occupied)){
+		const SquareIndex home = white?4:60;
+		if(can_castle_king && !(occupied & BitBoard::from_square_index(home + 1)) &&
+				!(occupied & BitBoard::from_square_index(home + 2)) &&
+				!get_attackers(home + 1, !white, occupied) &&
+				!get_attackers(home + 2, !white, occupied)){
+			moves.push_back(Move(home, home + 2));
+		}
+		if(can_castle_queen && !(occupied & BitBoard::from_square_index(home - 1)) &&
+				!(occupied & BitBoard::from_square_index(home - 2)) &&
+				!(occupied & BitBoard::from_square_index(home - 3)) &&
+				!get_attackers(home - 1, !white, occupied) &&
+				!get_attackers(home - 2, !white, occupied)){
+			moves.push_back(Move(home, home - 2));
+		}
+	}
+}
+
+BitBoard BoardState::get_occupied() const{
+	return core_.white_ | core_.black_;
+}
+
+BitBoard BoardState::get_pieces(const Piece piece) const{
+	const BitBoard color_board = color_of(piece) == Color::WHITE?core_.white_:core_.black_;
+	switch(kind_of(piece)){
+	case PieceKind::KING:
+		return core_.kings_ & color_board;
+	case PieceKind::QUEEN:
+		return core_.queens_ & color_board;
+	case PieceKind::BISHOP:
+		return core_.bishops_ & color_board;
+	case PieceKind::KNIGHT:
+		return core_.knights_ & color_board;
+	case PieceKind::ROOK:
+		return core_.rooks_ & color_board;
+	case PieceKind::PAWN:
+		return core_.pawns_ & color_board;
+	default:
+		throw "Invalid Piece passed to get_pieces.";
+	}
+}
+
+void BoardState::set_prefetch_hook(PrefetchHook hook, const void* context){
+	prefetch_hook_ = hook;
+	prefetch_context_ = context;
+}
+
+void BoardState::set_verify_repetition(const bool value){
+	if(get_record_length() != 0){
+		throw "set_verify_repetition called on a BoardState with a non-empty record.";
+	}
+	verify_repetition_ = value;
+}
+
+bool BoardState::is_repetition(const int count) const{
+	// Positions before the last irreversible move can't recur, and positions
+	// an odd number of halfmoves ago have the other side to move, so only
+	// every second key back to the threefold_repetition_clock_ is a candidate.
+	const std::size_t limit = std::min<std::size_t>(threefold_repetition_clock_,
+			get_record_length());
+	int occurrences = 1;
+	for(std::size_t plies_ago=2; plies_ago<=limit && occurrences<count; plies_ago+=2){
+		if(get_record_key(plies_ago) == hash_){
+			// Only look at the full state once the keys match.
+			if(!verify_repetition_ || get_record_core(plies_ago) == core_){
+				occurrences++;
+			}
+		}
+	}
+	return occurrences >= count;
+}
+
+bool BoardState::is_fifty_move_draw() const{
+	return halfmove_clock_ >= 100;
+}
+
+bool BoardState::is_insufficient_material() const{
+	if(core_.pawns_ | core_.rooks_ | core_.queens_){
+		return false;
+	}
+	const BitBoard minors = core_.bishops_ | core_.knights_;
+	if(minors.population_count() <= 1){
+		return true;
+	}
+	// Any number of bishops is insufficient if they all live on squares of
+	// one color, even if both sides have some.
+	constexpr BitBoard kLightSquares = BitBoard(0x55AA55AA55AA55AAULL);
+	return !core_.knights_ && (!(core_.bishops_ & kLightSquares) ||
+			!(core_.bishops_ & ~kLightSquares));
+}
+
+bool BoardState::is_draw(const int repetition_count) const{
+	return is_fifty_move_draw() || is_insufficient_material() ||
+			is_repetition(repetition_count);
+}
+
 Piece BoardState::get_piece_at(const SquareIndex square) const{
 	return piece_map_[square];
 }
@@ -637,28 +896,40 @@ void BoardState::set_black_castle_queen(const bool value){
 	core_.black_castle_queen_ = value;
 }
 
+SquareIndex BoardState::get_en_passant_square() const{
+	return core_.en_passant_square_;
+}
+void BoardState::set_en_passant_square(const SquareIndex value){
+	core_.en_passant_square_ = value;
+}
+
 void BoardState::compute_move_tables(){
+	if(!move_tables_){
+		move_tables_.reset(new MoveTables());
+	}
 	// TODO: This
 }
 
 void BoardState::update_redundant_data(){
-	occupied_ = (core_.white_ | core_.black_) ^ core_.en_passant_;
+	occupied_ = core_.white_ | core_.black_;
 	unoccupied_ = ~occupied_;
-	if(core_.whites_turn_){
-		own_ = core_.white_;
-		opponent_ = core_.black_ ^ core_.en_passant_;
-	}else{
-		own_ = core_.black_;
-		opponent_ = core_.white_ ^ core_.en_passant_;
-	}
+	own_ = core_.whites_turn_?core_.white_:core_.black_;
+	opponent_ = core_.whites_turn_?core_.black_:core_.white_;
 	own_complement_ = ~own_;
 	own_king_ = own_ & core_.kings_;
-	opponent_non_diagonal_sliders_ = opponent_ & core_.rooks_ & core_.queens_;
-	opponent_diagonal_sliders_ = opponent_ & core_.bishops_ & core_.queens_;
-	opponent_kinghts_ = opponent_ & core_.knights_;
+	const BitBoard non_diagonal_sliders = core_.rooks_ | core_.queens_;
+	const BitBoard diagonal_sliders = core_.bishops_ | core_.queens_;
+	own_non_diagonal_sliders_ = own_ & non_diagonal_sliders;
+	opponent_non_diagonal_sliders_ = opponent_ & non_diagonal_sliders;
+	own_diagonal_sliders_ = own_ & diagonal_sliders;
+	opponent_diagonal_sliders_ = opponent_ & diagonal_sliders;
+	own_knights_ = own_ & core_.knights_;
+	opponent_knights_ = opponent_ & core_.knights_;
+	own_pawns_ = own_ & core_.pawns_;
 	opponent_pawns_ = opponent_ & core_.pawns_;
 
 	own_king_square_ = own_king_.greatest_square_index();
+	opponent_king_square_ = (opponent_ & core_.kings_).greatest_square_index();
 }
 
 void BoardState::update_move_tables(const MoveRecord& record){
@@ -672,18 +943,67 @@ void BoardState::downdate_move_tables(const MoveRecord& record){
 SquareIndex BoardState::get_en_passant_target(
 		const SquareIndex en_passant_square){
 	const SquareIndex en_passant_rank = rank_index_of(en_passant_square);
-	const SquareIndex target_rank = en_passant_rank==3?2:5;
+	const SquareIndex target_rank = en_passant_rank==2?3:4;
 	const SquareIndex target_file = file_index_of(en_passant_square);
 	return square_index_of(target_rank, target_file);
 }
 
-MoveRecord BoardState::compute_move_record(const Move& move){
+/*
+ * The squares whose king or rook starts each castle.  A move from or to any
+ * of them loses the corresponding castle right.
+ */
+constexpr BitBoard kWhiteCastleKingSquares = kSquare4 | kSquare7;
+constexpr BitBoard kWhiteCastleQueenSquares = kSquare4 | kSquare0;
+constexpr BitBoard kBlackCastleKingSquares = kSquare60 | kSquare63;
+constexpr BitBoard kBlackCastleQueenSquares = kSquare60 | kSquare56;
+
+template<class Policy>
+void BoardState::finish_move_record(MoveRecord& result) const{
+	// Set the member for pre-existing en passant opportunity, if any.
+	result.en_passant_square_before = core_.en_passant_square_;
+
+	// Determine changes to castle rights.  Moving the king or the rook, or
+	// capturing the rook, loses the right, so it's enough to look at which
+	// squares the move touched.
+	const BitBoard touched = BitBoard::from_square_index(result.from_square) |
+			BitBoard::from_square_index(result.to_square);
+	result.lost_white_castle_king = core_.white_castle_king_ &&
+			(touched & kWhiteCastleKingSquares);
+	result.lost_white_castle_queen = core_.white_castle_queen_ &&
+			(touched & kWhiteCastleQueenSquares);
+	result.lost_black_castle_king = core_.black_castle_king_ &&
+			(touched & kBlackCastleKingSquares);
+	result.lost_black_castle_queen = core_.black_castle_queen_ &&
+			(touched & kBlackCastleQueenSquares);
+
+	// Determine changes to threefold repetition and halfmove
+	// clocks.
+	if(!Policy::kClocks){
+		return;
+	}
+	if((result.captured_piece != Piece::NO_PIECE) ||
+			(kind_of(result.moved_piece) == PieceKind::PAWN)){
+		// In this case, both clocks will be reset.
+		result.halfmove_clock_after = 0;
+		result.threefold_repetition_clock_after = 0;
+	}else if(result.lost_white_castle_king || result.lost_white_castle_queen ||
+			result.lost_black_castle_king || result.lost_black_castle_queen){
+		result.halfmove_clock_after = halfmove_clock_ + 1;
+		result.threefold_repetition_clock_after = 0;
+	}else{
+		result.halfmove_clock_after = halfmove_clock_ + 1;
+		result.threefold_repetition_clock_after = threefold_repetition_clock_ + 1;
+	}
+	result.halfmove_clock_before = halfmove_clock_;
+	result.threefold_repetition_clock_before = threefold_repetition_clock_;
+}
+
+template<class Policy>
+MoveRecord BoardState::compute_move_record(const Move& move) const{
 	const Piece moved_piece = get_piece_at(move.from_square);
 	const PieceKind moved_piece_kind = kind_of(moved_piece);
 	const Color moved_piece_color = color_of(moved_piece);
 	const Piece to_piece = get_piece_at(move.to_square);
-	const PieceKind to_piece_kind = kind_of(to_piece);
-	const Color to_piece_color = color_of(to_piece);
 	MoveRecord result;
 	result.from_square = move.from_square;
 	result.to_square = move.to_square;
@@ -694,7 +1014,7 @@ MoveRecord BoardState::compute_move_record(const Move& move){
 
 	// Check for special move types.
 	from_file = file_index_of(result.from_square);
-	if(to_piece_kind == PieceKind::EN_PASSANT
+	if(move.to_square == core_.en_passant_square_
 			&& moved_piece_kind == PieceKind::PAWN){
 		// Assuming the current position was achieved legally,
 		// the above conditions guarantee that this move is an
@@ -711,7 +1031,7 @@ MoveRecord BoardState::compute_move_record(const Move& move){
 			// Assuming this is a legal move, the above conditions
 			// guarantee that this move is a castle.  Proceed accordingly.
 			from_rank = rank_index_of(result.from_square);
-			if(from_file < 4){
+			if(to_file < 4){
 				result.castled_from_square = square_index_of(from_rank, 0);
 			}else{
 				result.castled_from_square = square_index_of(from_rank, 7);
@@ -727,12 +1047,14 @@ MoveRecord BoardState::compute_move_record(const Move& move){
 
 
 		}
-	}else if(to_piece != Piece::NO_PIECE){
-		// Since en passant has already been ruled out, and since we are
-		// assuming the move is legal, this is a regular capture.
+	} // End check for special move types
+
+	// The target square of an en passant capture or a castle is empty, so
+	// any piece there is taken by a regular capture, by the king as well.
+	if(to_piece != Piece::NO_PIECE){
 		result.captured_square = result.to_square;
 		result.captured_piece = to_piece;
-	} // End check for special move types
+	}
 
 	// Check for promotion.
 	if(move.promotion != Piece::NO_PIECE){
@@ -755,82 +1077,90 @@ MoveRecord BoardState::compute_move_record(const Move& move){
 			// need to check for that.
 			en_passant_rank_after = (moved_piece_color == Color::BLACK)?(to_rank + 1):(from_rank + 1);
 			result.en_passant_square_after = square_index_of(en_passant_rank_after, from_file);
-			result.en_passant_piece_after = (moved_piece_color == Color::BLACK)?(Piece::BLACK_EN_PASSANT):(Piece::WHITE_EN_PASSANT);
 		}
 	}
 
-	// Set the members for pre-existing en passant opportunity, if any.
-	result.en_passant_square_before = en_passant_square_;
-	if(result.en_passant_square_before != kNoEnPassant){
-		result.en_passant_piece_before = get_piece_at(result.en_passant_square_before);
-	} // Otherwise, result.en_passant_piece_before is already Piece::NO_PIECE.
-
-	// Determine changes to castle rights.
-	if(result.moved_piece == Piece::WHITE_KING){
-		result.lost_white_castle_king = core_.white_castle_king_;
-		result.lost_white_castle_queen = core_.white_castle_queen_;
-	}else if(result.moved_piece == Piece::BLACK_KING){
-		result.lost_black_castle_king = core_.white_castle_king_;
-		result.lost_black_castle_queen = core_.white_castle_queen_;
-	}else if(result.moved_piece == Piece::WHITE_ROOK){
-		if(from_file==0){
-			result.lost_white_castle_queen = core_.white_castle_queen_;
-		}else if(from_file==7){
-			result.lost_white_castle_king = core_.white_castle_king_;
-		}
-	}else if(result.moved_piece == Piece::BLACK_ROOK){
-		if(from_file==0){
-			result.lost_black_castle_queen = core_.black_castle_queen_;
-		}else if(from_file==7){
-			result.lost_black_castle_king = core_.black_castle_king_;
-		}
-	}
+	finish_move_record<Policy>(result);
 
-	// Determine changes to threefold repetition and halfmove
-	// clocks.
-	if((to_piece != Piece::NO_PIECE) || (moved_piece_kind == PieceKind::PAWN)){
-		// In this case, both clocks will be reset.
-		result.halfmove_clock_after = 0;
-		result.threefold_repetition_clock_after = 0;
-	}else if(result.lost_white_castle_king || result.lost_white_castle_queen ||
-			result.lost_black_castle_king || result.lost_black_castle_queen){
-		result.halfmove_clock_after = halfmove_clock_ + 1;
-		result.threefold_repetition_clock_after = 0;
-	}else{
-		result.halfmove_clock_after = halfmove_clock_ + 1;
-		result.threefold_repetition_clock_after = threefold_repetition_clock_ + 1;
-	}
-	result.halfmove_clock_before = halfmove_clock_;
-	result.threefold_repetition_clock_before = threefold_repetition_clock_;
+	return result;
+}
 
+template<class Policy>
+MoveRecord BoardState::compute_trusted_move_record(const Move& move) const{
+	const Piece moved_piece = get_piece_at(move.from_square);
+	const PieceKind moved_piece_kind = kind_of(moved_piece);
+	if(moved_piece_kind == PieceKind::PAWN || moved_piece_kind == PieceKind::KING){
+		// Only pawn and king moves can be special.
+		return compute_move_record<Policy>(move);
+	}
+	MoveRecord result;
+	result.from_square = move.from_square;
+	result.to_square = move.to_square;
+	result.moved_piece = moved_piece;
+	result.placed_piece = moved_piece;
+	result.captured_piece = get_piece_at(move.to_square);
+	if(result.captured_piece != Piece::NO_PIECE){
+		result.captured_square = move.to_square;
+	}
+	finish_move_record<Policy>(result);
 	return result;
 }
 
+template<class Policy>
 MoveRecord BoardState::make_move(const Move move){
-	const MoveRecord record = compute_move_record(move);
-	apply_move_record(record);
+	const MoveRecord record = compute_move_record<Policy>(move);
+	if(Policy::kPrefetch && prefetch_hook_){
+		prefetch_hook_(prefetch_context_, ZobristHasher::update(hash_, record));
+	}
+	apply_move_record<Policy>(record);
 	return record;
 }
 
+template<class Policy>
+void BoardState::replay(const Move* moves, const std::size_t n, ZobristKey* keys){
+	for(std::size_t i=0; i<n; i++){
+		apply_move_record<Policy>(compute_trusted_move_record<Policy>(moves[i]));
+		if(keys){
+			keys[i] = hash_;
+		}
+	}
+}
+
+template<class Policy>
 void BoardState::unmake_move(const MoveRecord& record){
-	// TODO: This
+	// Forget the state being returned to; it is current again.
+	if(Policy::kHistory){
+		pop_record();
+	}
 
 	// Downdate the move tables.
-	downdate_move_tables(record);
+	if(Policy::kMoveTables){
+		downdate_move_tables(record);
+	}
 
 	// Downdate the Zobrist hash (which is the same as updating).
-	hash_ = ZobristHasher::update(hash_, record);
+	if(Policy::kHash){
+		hash_ = ZobristHasher::update(hash_, record);
+	}
+	if(Policy::kEvalKeys){
+		pawn_key_ = ZobristHasher::update_pawns(pawn_key_, record);
+		material_key_ += material_key_of(record.moved_piece) +
+				material_key_of(record.captured_piece) -
+				material_key_of(record.placed_piece);
+	}
 
 	// Change whose turn it is.
-	set_whites_turn(!get_whites_turn());
+	flip_turn<Policy>();
 
-	// Decrement the counters.
-	fullmove_counter_ -= core_.whites_turn_?0:1;
-	halfmove_counter_--;
+	if(Policy::kClocks){
+		// Decrement the counters.
+		fullmove_counter_ -= core_.whites_turn_?0:1;
+		halfmove_counter_--;
 
-	// Set the clocks.
-	halfmove_clock_ = record.halfmove_clock_before;
-	threefold_repetition_clock_ = record.threefold_repetition_clock_before;
+		// Set the clocks.
+		halfmove_clock_ = record.halfmove_clock_before;
+		threefold_repetition_clock_ = record.threefold_repetition_clock_before;
+	}
 
 	// Downdate castle rights.
 	core_.white_castle_king_ ^= record.lost_white_castle_king;
@@ -838,47 +1168,43 @@ void BoardState::unmake_move(const MoveRecord& record){
 	core_.black_castle_king_ ^= record.lost_black_castle_king;
 	core_.black_castle_queen_ ^= record.lost_black_castle_queen;
 
-	// Unset the en passant square.
-	raw_unset_en_passant();
-
 	// Downdate the board based on the moved, placed, captured, and
 	// castled pieces.
-	raw_unplace_piece(record.placed_piece, record.to_square);
+	raw_unplace_piece<Policy>(record.placed_piece, record.to_square);
 	if(record.castled_piece != Piece::NO_PIECE){
-		raw_unplace_piece(record.castled_piece, record.castled_to_square);
-		raw_place_piece(record.castled_piece, record.castled_from_square);
+		raw_unplace_piece<Policy>(record.castled_piece, record.castled_to_square);
+		raw_place_piece<Policy>(record.castled_piece, record.castled_from_square);
 	}
 	if(record.captured_piece != Piece::NO_PIECE){
-		raw_place_piece(record.captured_piece, record.captured_square);
+		raw_place_piece<Policy>(record.captured_piece, record.captured_square);
 	}
-	raw_place_piece(record.moved_piece, record.from_square);
+	raw_place_piece<Policy>(record.moved_piece, record.from_square);
 
 	// Set the en passant square to its old value
-	if(record.en_passant_piece_before != Piece::NO_PIECE){
-		raw_set_en_passant(record.en_passant_piece_before, record.en_passant_square_before);
-	}
+	core_.en_passant_square_ = record.en_passant_square_before;
 }
 
+template<class Policy>
 void BoardState::apply_move_record(const MoveRecord& record){
-	// Remove previous en passant position
-	raw_unset_en_passant();
+	// Remember the state being left, for repetition detection.
+	if(Policy::kHistory){
+		push_record();
+	}
 
 	// Update the board based on the moved, placed, captured, and
 	// castled pieces.
-	raw_unplace_piece(record.moved_piece, record.from_square);
+	raw_unplace_piece<Policy>(record.moved_piece, record.from_square);
 	if(record.captured_piece != Piece::NO_PIECE){
-		raw_unplace_piece(record.captured_piece, record.captured_square);
+		raw_unplace_piece<Policy>(record.captured_piece, record.captured_square);
 	}
 	if(record.castled_piece != Piece::NO_PIECE){
-		raw_unplace_piece(record.castled_piece, record.castled_from_square);
-		raw_place_piece(record.castled_piece, record.castled_to_square);
+		raw_unplace_piece<Policy>(record.castled_piece, record.castled_from_square);
+		raw_place_piece<Policy>(record.castled_piece, record.castled_to_square);
 	}
-	raw_place_piece(record.placed_piece, record.to_square);
+	raw_place_piece<Policy>(record.placed_piece, record.to_square);
 
 	// Update the en passant square.
-	if(record.en_passant_piece_after != Piece::NO_PIECE){
-		raw_set_en_passant(record.en_passant_piece_after, record.en_passant_square_after);
-	}
+	core_.en_passant_square_ = record.en_passant_square_after;
 
 	// Update castle rights.
 	core_.white_castle_king_ ^= record.lost_white_castle_king;
@@ -886,22 +1212,102 @@ void BoardState::apply_move_record(const MoveRecord& record){
 	core_.black_castle_king_ ^= record.lost_black_castle_king;
 	core_.black_castle_queen_ ^= record.lost_black_castle_queen;
 
-	// Update the clocks.
-	halfmove_clock_ = record.halfmove_clock_after;
-	threefold_repetition_clock_ = record.threefold_repetition_clock_after;
+	if(Policy::kClocks){
+		// Update the clocks.
+		halfmove_clock_ = record.halfmove_clock_after;
+		threefold_repetition_clock_ = record.threefold_repetition_clock_after;
 
-	// Advance the counters.
-	fullmove_counter_ += core_.whites_turn_?0:1;
-	halfmove_counter_++;
+		// Advance the counters.
+		fullmove_counter_ += core_.whites_turn_?0:1;
+		halfmove_counter_++;
+	}
 
 	// Change whose turn it is.
-	set_whites_turn(!get_whites_turn());
+	flip_turn<Policy>();
 
 	// Update the Zobrist hash.
-	hash_ = ZobristHasher::update(hash_, record);
+	if(Policy::kHash){
+		hash_ = ZobristHasher::update(hash_, record);
+	}
+	if(Policy::kEvalKeys){
+		pawn_key_ = ZobristHasher::update_pawns(pawn_key_, record);
+		material_key_ += material_key_of(record.placed_piece) -
+				material_key_of(record.moved_piece) -
+				material_key_of(record.captured_piece);
+	}
 
 	// Update the move tables.
-	update_move_tables(record);
+	if(Policy::kMoveTables){
+		update_move_tables(record);
+	}
+}
+
+template<class Policy>
+NullMoveRecord BoardState::make_null_move(){
+	NullMoveRecord record;
+	record.en_passant_square_before = core_.en_passant_square_;
+	record.halfmove_clock_before = halfmove_clock_;
+	record.threefold_repetition_clock_before = threefold_repetition_clock_;
+	if(Policy::kPrefetch && prefetch_hook_){
+		prefetch_hook_(prefetch_context_, ZobristHasher::update(hash_, record));
+	}
+
+	// Remember the state being left, so the record stays one entry per ply.
+	if(Policy::kHistory){
+		push_record();
+	}
+
+	// A null move can't capture en passant, so the opportunity is gone.
+	core_.en_passant_square_ = kNoEnPassant;
+
+	if(Policy::kClocks){
+		// Update the clocks.
+		halfmove_clock_++;
+		threefold_repetition_clock_ = 0;
+
+		// Advance the counters.
+		fullmove_counter_ += core_.whites_turn_?0:1;
+		halfmove_counter_++;
+	}
+
+	// Change whose turn it is.
+	flip_turn<Policy>();
+
+	// Update the Zobrist hash.
+	if(Policy::kHash){
+		hash_ = ZobristHasher::update(hash_, record);
+	}
+
+	return record;
+}
+
+template<class Policy>
+void BoardState::unmake_null_move(const NullMoveRecord& record){
+	// Forget the state being returned to; it is current again.
+	if(Policy::kHistory){
+		pop_record();
+	}
+
+	// Downdate the Zobrist hash (which is the same as updating).
+	if(Policy::kHash){
+		hash_ = ZobristHasher::update(hash_, record);
+	}
+
+	// Change whose turn it is.
+	flip_turn<Policy>();
+
+	if(Policy::kClocks){
+		// Decrement the counters.
+		fullmove_counter_ -= core_.whites_turn_?0:1;
+		halfmove_counter_--;
+
+		// Set the clocks.
+		halfmove_clock_ = record.halfmove_clock_before;
+		threefold_repetition_clock_ = record.threefold_repetition_clock_before;
+	}
+
+	// Restore the en passant opportunity.
+	core_.en_passant_square_ = record.en_passant_square_before;
 }
 
 BoardState BoardState::from_fen(std::string fen){
@@ -917,7 +1323,7 @@ BoardState BoardState::from_fen(std::string fen){
 	std::string board_part = parts[0];
 	std::string turn_part = parts[1];
 	std::string castle_rights_part;
-	if(parts.size() == 6){
+	if(parts.size() == 6 && parts[2] != "-"){
 		castle_rights_part = parts[2];
 	}
 	std::string en_passant_part = parts[parts.size() == 6?3:2];
@@ -954,7 +1360,7 @@ BoardState BoardState::from_fen(std::string fen){
 			}
 		}
 	}
-	// All pieces have now been placed with the possible exception of en passant.
+	// All pieces have now been placed.
 
 	// Set whose turn it is.
 	if(turn_part.size() != 1){
@@ -991,20 +1397,26 @@ BoardState BoardState::from_fen(std::string fen){
 
 	// Set en passant.
 	if(en_passant_part != "-"){
-		result.raw_set_en_passant(
-				result.core_.whites_turn_?Piece::WHITE_EN_PASSANT:Piece::BLACK_EN_PASSANT,
-				algebraic_to_square_index(en_passant_part));
+		result.set_en_passant_square(algebraic_to_square_index(en_passant_part));
 	}
 
 	// Set the clocks.
 	result.halfmove_clock_ = stoi(halfmove_clock_part);
 	result.fullmove_counter_ = stoi(fullmove_counter_part);
 
+	// Bring the redundant data in line with the turn that was set.
+	result.update_redundant_data();
+
 	// Calculate the current Zobrist hash.
 	result.hash_ = ZobristHasher::hash(result);
+	result.pawn_key_ = ZobristHasher::hash_pawns(result);
+	result.material_key_ = 0;
+	for(const Piece piece : result.piece_map_){
+		result.material_key_ += material_key_of(piece);
+	}
 
-	// Calculate available moves.
-	result.compute_move_tables();
+	// The move tables are not computed here.  Callers that need them
+	// compute them, which also allocates them.
 
 	return result;
 }
@@ -1028,7 +1440,7 @@ std::string BoardState::to_fen() const{
 			SquareIndex square = square_index_of(rank, file);
 			piece = piece_map_[square];
 			piece_char = piece_to_fen(piece);
-			if(piece_char == '-' || piece_char == '*'){
+			if(piece_char == '-'){
 				empty_count++;
 			}else{
 				if(empty_count > 0){
@@ -1073,8 +1485,8 @@ std::string BoardState::to_fen() const{
 	// Construct the part that specifies the available en
 	// passant.
 	std::string en_passant_part;
-	if(en_passant_square_ != kNoEnPassant){
-		en_passant_part += square_index_to_algebraic(en_passant_square_);
+	if(core_.en_passant_square_ != kNoEnPassant){
+		en_passant_part += square_index_to_algebraic(core_.en_passant_square_);
 	}else{
 		en_passant_part += '-';
 	}
@@ -1293,7 +1705,7 @@ BitBoard BoardState::compute_threatening_squares(SquareIndex square){
 	/*
 	 * Check for attacking knights.
 	 */
-	tmp = square_board.knight_step() & opponent_kinghts_;
+	tmp = square_board.knight_step() & opponent_knights_;
 	if(tmp){
 		result &= tmp;
 	}
@@ -1402,58 +1814,168 @@ BitBoard BoardState::compute_threatening_squares(SquareIndex square){
 	return result;
 }
 
-ZobristKey ZobristHasher::get_table_entry(SquareIndex square, Piece piece){
-	return zobrist_table_[kSquaresPerBoard * square + piece_index_of(piece)];
-}
+// Instantiate the make and unmake functions for each policy, so their
+// definitions can stay in this file.
+#define BOARDLIB_INSTANTIATE_POLICY(Policy) \
+	template void BoardState::flip_turn<Policy>(); \
+	template void BoardState::raw_place_piece<Policy>(const Piece, const SquareIndex); \
+	template void BoardState::raw_unplace_piece<Policy>(const Piece, const SquareIndex); \
+	template MoveRecord BoardState::compute_move_record<Policy>(const Move&) const; \
+	template void BoardState::apply_move_record<Policy>(const MoveRecord&); \
+	template MoveRecord BoardState::make_move<Policy>(const Move); \
+	template void BoardState::replay<Policy>(const Move*, const std::size_t, ZobristKey*); \
+	template void BoardState::unmake_move<Policy>(const MoveRecord&); \
+	template NullMoveRecord BoardState::make_null_move<Policy>(); \
+	template void BoardState::unmake_null_move<Policy>(const NullMoveRecord&);
+BOARDLIB_INSTANTIATE_POLICY(FullPolicy)
+BOARDLIB_INSTANTIATE_POLICY(SearchPolicy)
+BOARDLIB_INSTANTIATE_POLICY(PerftPolicy)
+BOARDLIB_INSTANTIATE_POLICY(ReplayPolicy)
+#undef BOARDLIB_INSTANTIATE_POLICY
 
-ZobristKey ZobristHasher::hash(const BoardState& state){
-	Piece piece;
-	ZobristKey result = 0;
-	for(SquareIndex i=0; i<kSquaresPerBoard; i++){
-		piece = state.get_piece_at(i);
-		if(piece != Piece::NO_PIECE){
-			result ^= get_table_entry(i, piece);
-		}
-	}
+/*
+ * The pieces hashed, in the order of BasicZobristHasher::get_piece_sets.
+ */
+constexpr Piece kHashedPieces[] = {Piece::WHITE_PAWN, Piece::BLACK_PAWN, Piece::WHITE_KNIGHT,
+		Piece::BLACK_KNIGHT, Piece::WHITE_BISHOP, Piece::BLACK_BISHOP, Piece::WHITE_ROOK,
+		Piece::BLACK_ROOK, Piece::WHITE_QUEEN, Piece::BLACK_QUEEN, Piece::WHITE_KING,
+		Piece::BLACK_KING};
+
+template<class Key>
+Key BasicZobristHasher<Key>::hash_flags(const BoardState& state){
+	Key result = Key();
 	if(state.get_whites_turn()){
-		result ^= kZobristWhitesTurn;
+		result ^= get_whites_turn_entry();
 	}
 	if(state.get_white_castle_king()){
-		result ^= kZobristWhiteCastleKing;
+		result ^= get_white_castle_king_entry();
 	}
 	if(state.get_white_castle_queen()){
-		result ^= kZobristWhiteCastleQueen;
+		result ^= get_white_castle_queen_entry();
 	}
 	if(state.get_black_castle_king()){
-		result ^= kZobristBlackCastleKing;
+		result ^= get_black_castle_king_entry();
 	}
 	if(state.get_black_castle_queen()){
-		result ^= kZobristBlackCastleQueen;
+		result ^= get_black_castle_queen_entry();
+	}
+	if(state.get_en_passant_square() != kNoEnPassant){
+		result ^= get_en_passant_entry(state.get_en_passant_square());
 	}
 	return result;
 }
 
-ZobristKey ZobristHasher::update(const ZobristKey previous_key, const MoveRecord& record){
-	ZobristKey result = previous_key;
+template<class Key>
+void BasicZobristHasher<Key>::get_piece_sets(const BoardState& state, BitBoard* sets){
+	const BoardStateCore& core = state.core_;
+	const BitBoard kinds[] = {core.pawns_, core.knights_, core.bishops_, core.rooks_, core.queens_,
+			core.kings_};
+	for(std::size_t kind=0; kind<kNumberOfHashedPieces / 2; kind++){
+		sets[2*kind] = kinds[kind] & core.white_;
+		sets[2*kind + 1] = kinds[kind] & core.black_;
+	}
+}
+
+template<class Key>
+Key BasicZobristHasher<Key>::hash(const BoardState& state){
+	// Walk the set bits of each piece set rather than the piece map, so
+	// that the only branches are the ends of the loops and the table loads
+	// can overlap.
+	BitBoard sets[kNumberOfHashedPieces];
+	get_piece_sets(state, sets);
+	Key result = Key();
+	for(std::size_t piece=0; piece<kNumberOfHashedPieces; piece++){
+		while(sets[piece]){
+			result ^= get_table_entry(sets[piece].pop_least_significant_1_bit().greatest_square_index(),
+					kHashedPieces[piece]);
+		}
+	}
+	return result ^ hash_flags(state);
+}
+
+template<class Key>
+void BasicZobristHasher<Key>::hash(const BoardState* states, const std::size_t n, Key* keys){
+	// Each lane keeps its own key, so the loads of one lane don't wait on
+	// the others.  Hashing doesn't wait on anything but the loads of the
+	// board states themselves, so fetch the next lanes' boards ahead.
+	constexpr std::size_t kLanes = 4;
+	std::size_t i = 0;
+	for(; i + kLanes <= n; i += kLanes){
+		for(std::size_t lane=0; lane<kLanes && i + kLanes + lane < n; lane++){
+			// The core is in the first cache line.
+			__builtin_prefetch(&states[i + kLanes + lane]);
+		}
+		BitBoard sets[kLanes][kNumberOfHashedPieces];
+		for(std::size_t lane=0; lane<kLanes; lane++){
+			get_piece_sets(states[i + lane], sets[lane]);
+		}
+		Key lanes[kLanes] = {};
+		for(std::size_t piece=0; piece<kNumberOfHashedPieces; piece++){
+			for(std::size_t lane=0; lane<kLanes; lane++){
+				while(sets[lane][piece]){
+					lanes[lane] ^= get_table_entry(
+							sets[lane][piece].pop_least_significant_1_bit().greatest_square_index(),
+							kHashedPieces[piece]);
+				}
+			}
+		}
+		for(std::size_t lane=0; lane<kLanes; lane++){
+			keys[i + lane] = lanes[lane] ^ hash_flags(states[i + lane]);
+		}
+	}
+	for(; i<n; i++){
+		keys[i] = hash(states[i]);
+	}
+}
+
+template<class Key>
+Key BasicZobristHasher<Key>::hash_pawns(const BoardState& state){
+	Key result = Key();
+	for(const Piece pawn : {Piece::WHITE_PAWN, Piece::BLACK_PAWN}){
+		BitBoard pawns = state.get_pieces(pawn);
+		while(pawns){
+			result ^= get_table_entry(pawns.pop_least_significant_1_bit().greatest_square_index(), pawn);
+		}
+	}
+	return result;
+}
+
+template<class Key>
+Key BasicZobristHasher<Key>::update_pawns(const Key previous_key, const MoveRecord& record){
+	Key result = previous_key;
+	if(kind_of(record.moved_piece) == PieceKind::PAWN){
+		result ^= get_table_entry(record.from_square, record.moved_piece);
+		if(record.placed_piece == record.moved_piece){
+			result ^= get_table_entry(record.to_square, record.placed_piece);
+		}
+	}
+	if(kind_of(record.captured_piece) == PieceKind::PAWN){
+		result ^= get_table_entry(record.captured_square, record.captured_piece);
+	}
+	return result;
+}
+
+template<class Key>
+Key BasicZobristHasher<Key>::update(const Key previous_key, const MoveRecord& record){
+	Key result = previous_key;
 
 	if(record.lost_black_castle_queen){
-		result ^= kZobristBlackCastleQueen;
+		result ^= get_black_castle_queen_entry();
 	}
 	if(record.lost_black_castle_king){
-		result ^= kZobristBlackCastleKing;
+		result ^= get_black_castle_king_entry();
 	}
 	if(record.lost_white_castle_queen){
-		result ^= kZobristWhiteCastleQueen;
+		result ^= get_white_castle_queen_entry();
 	}
 	if(record.lost_white_castle_king){
-		result ^= kZobristWhiteCastleKing;
+		result ^= get_white_castle_king_entry();
 	}
 
 	// The turn always flips, obviously.
-	result ^= kZobristWhitesTurn;
+	result ^= get_whites_turn_entry();
 
-	// Account for all changed pieces, including available
-	// en passant captures, which are treated as pieces.
+	// Account for all changed pieces.
 	result ^= get_table_entry(record.from_square, record.moved_piece);
 	if(record.captured_piece != Piece::NO_PIECE){
 		result ^= get_table_entry(record.captured_square, record.captured_piece);
@@ -1463,23 +1985,172 @@ ZobristKey ZobristHasher::update(const ZobristKey previous_key, const MoveRecord
 		result ^= get_table_entry(record.castled_from_square, record.castled_piece);
 		result ^= get_table_entry(record.castled_to_square, record.castled_piece);
 	}
-	if(record.en_passant_piece_after != Piece::NO_PIECE){
-		result ^= get_table_entry(record.en_passant_square_after,
-				record.en_passant_piece_after);
+
+	// Account for the available en passant captures.
+	if(record.en_passant_square_after != kNoEnPassant){
+		result ^= get_en_passant_entry(record.en_passant_square_after);
+	}
+	if(record.en_passant_square_before != kNoEnPassant){
+		result ^= get_en_passant_entry(record.en_passant_square_before);
+	}
+
+	return result;
+}
+
+
+template<class Key>
+Key BasicZobristHasher<Key>::update(const Key previous_key, const NullMoveRecord& record){
+	Key result = previous_key ^ get_whites_turn_entry();
+	if(record.en_passant_square_before != kNoEnPassant){
+		result ^= get_en_passant_entry(record.en_passant_square_before);
+	}
+	return result;
+}
+
+
+#include "polyglot.inc"
+
+PolyglotHasher::PolyglotHasher() : random_(kPolyglotRandom64){}
+
+PolyglotHasher::PolyglotHasher(const RandomTable& random) : random_(random){}
+
+PolyglotHasher PolyglotHasher::from_file(const std::string& path){
+	std::ifstream file(path);
+	if(!file){
+		throw "Could not open the Polyglot random numbers.";
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string text = contents.str();
+
+	RandomTable random;
+	unsigned int count = 0;
+	std::size_t position = text.find("0x");
+	while(position != std::string::npos && count < kRandomTableSize){
+		ZobristKey value = 0;
+		std::size_t i = position + 2;
+		for(; i < text.size() && std::isxdigit(static_cast<unsigned char>(text[i])); i++){
+			const char digit = std::tolower(static_cast<unsigned char>(text[i]));
+			value = (value << 4) | (digit <= '9'?digit - '0':digit - 'a' + 10);
+		}
+		if(i > position + 2){
+			random[count++] = value;
+		}
+		position = text.find("0x", i);
+	}
+	if(count < kRandomTableSize){
+		throw "Too few Polyglot random numbers.";
 	}
-	if(record.en_passant_piece_before != Piece::NO_PIECE){
-		result ^= get_table_entry(record.en_passant_square_before,
-				record.en_passant_piece_before);
+	return PolyglotHasher(random);
+}
+
+ZobristKey PolyglotHasher::get_en_passant_entry(const SquareIndex square,
+		const BitBoard capturers) const{
+	// The pawn that made the double step is just past the en passant square.
+	const BitBoard pushed = rank_index_of(square) == 2?
+			BitBoard::from_square_index(square).step_north():
+			BitBoard::from_square_index(square).step_south();
+	if((pushed.step_east() | pushed.step_west()) & capturers){
+		return random_[kEnPassantIndex + file_index_of(square)];
 	}
+	return 0;
+}
 
+ZobristKey PolyglotHasher::hash(const BoardState& state) const{
+	ZobristKey result = 0;
+	for(SquareIndex i=0; i<kSquaresPerBoard; i++){
+		const Piece piece = state.get_piece_at(i);
+		if(piece != Piece::NO_PIECE){
+			result ^= get_piece_entry(i, piece);
+		}
+	}
+	if(state.get_white_castle_king()){
+		result ^= random_[kCastleIndex];
+	}
+	if(state.get_white_castle_queen()){
+		result ^= random_[kCastleIndex + 1];
+	}
+	if(state.get_black_castle_king()){
+		result ^= random_[kCastleIndex + 2];
+	}
+	if(state.get_black_castle_queen()){
+		result ^= random_[kCastleIndex + 3];
+	}
+	if(state.get_en_passant_square() != kNoEnPassant){
+		result ^= get_en_passant_entry(state.get_en_passant_square(), state.get_pieces(
+				state.get_whites_turn()?Piece::WHITE_PAWN:Piece::BLACK_PAWN));
+	}
+	if(state.get_whites_turn()){
+		result ^= random_[kTurnIndex];
+	}
 	return result;
 }
 
+ZobristKey PolyglotHasher::update(const ZobristKey previous_key, const BoardState& state,
+		const MoveRecord& record) const{
+	ZobristKey result = previous_key ^ random_[kTurnIndex];
+
+	if(record.lost_white_castle_king){
+		result ^= random_[kCastleIndex];
+	}
+	if(record.lost_white_castle_queen){
+		result ^= random_[kCastleIndex + 1];
+	}
+	if(record.lost_black_castle_king){
+		result ^= random_[kCastleIndex + 2];
+	}
+	if(record.lost_black_castle_queen){
+		result ^= random_[kCastleIndex + 3];
+	}
+
+	result ^= get_piece_entry(record.from_square, record.moved_piece);
+	if(record.captured_piece != Piece::NO_PIECE){
+		result ^= get_piece_entry(record.captured_square, record.captured_piece);
+	}
+	result ^= get_piece_entry(record.to_square, record.placed_piece);
+	if(record.castled_piece != Piece::NO_PIECE){
+		result ^= get_piece_entry(record.castled_from_square, record.castled_piece);
+		result ^= get_piece_entry(record.castled_to_square, record.castled_piece);
+	}
+
+	// The en passant square after the move counts if the side now to move
+	// can take, and the one before if the mover's pawns, as they were
+	// before the move, could.
+	if(record.en_passant_square_after != kNoEnPassant){
+		result ^= get_en_passant_entry(record.en_passant_square_after, state.get_pieces(
+				state.get_whites_turn()?Piece::WHITE_PAWN:Piece::BLACK_PAWN));
+	}
+	if(record.en_passant_square_before != kNoEnPassant){
+		const Piece pawn = color_of(record.moved_piece) == Color::WHITE?
+				Piece::WHITE_PAWN:Piece::BLACK_PAWN;
+		BitBoard pawns_before = state.get_pieces(pawn) & ~BitBoard::from_square_index(record.to_square);
+		if(record.moved_piece == pawn){
+			pawns_before |= BitBoard::from_square_index(record.from_square);
+		}
+		result ^= get_en_passant_entry(record.en_passant_square_before, pawns_before);
+	}
+	return result;
+}
+
+ZobristKey PolyglotHasher::update(const ZobristKey previous_key, const BoardState& state,
+		const NullMoveRecord& record) const{
+	ZobristKey result = previous_key ^ random_[kTurnIndex];
+	if(record.en_passant_square_before != kNoEnPassant){
+		// The side that passed was the one that could have taken.
+		result ^= get_en_passant_entry(record.en_passant_square_before, state.get_pieces(
+				state.get_whites_turn()?Piece::BLACK_PAWN:Piece::WHITE_PAWN));
+	}
+	return result;
+}
 
 
 // See https://stackoverflow.com/questions/8016780/undefined-reference-to-static-constexpr-char
 // for an unsatisfying explanation as to why this external declaration is necessary.
-constexpr std::array<ZobristKey, kSquaresPerBoard*(ZobristHasher::kNumberOfPieceTypes)> ZobristHasher::zobrist_table_;
+constexpr std::array<ZobristKey, kSquaresPerBoard*(ZobristTable::kNumberOfPieceTypes)> ZobristTable::zobrist_table_;
+constexpr std::array<ZobristKey, ZobristTable::kWhitesTurnIndex + 5> ZobristTable::high_table_;
+
+template class BasicZobristHasher<ZobristKey>;
+template class BasicZobristHasher<ZobristKey128>;
 
 
 }; // namespace boardlib
@@ -1,15 +1,342 @@
-//============================================================================
-// Name        : chessai2.cpp
-// Author      : 
-// Version     :
-// Copyright   : Your copyright notice
-// Description : Hello World in C++, Ansi-style
-//============================================================================
+/*
+ * chessai2.cc
+ *
+ *  A UCI front end for searchlib.  It understands enough of the protocol
+ *  to set up positions and search them to a fixed depth or node count,
+ *  under a clock, or until told to stop.  Searches run on their own
+ *  thread, so that commands such as stop and isready are read meanwhile.
+ */
 
+#include <boardlib.h>
+#include <evallib.h>
+#include <searchlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
-using namespace std;
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace boardlib;
+using namespace searchlib;
+
+namespace {
+
+const std::string kStartingPosition =
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+/*
+ * The depth searched by a go command without limits.
+ */
+constexpr int kDefaultDepth = 6;
+
+/*
+ * The transposition table size in MiB, and its bounds, as the Hash option.
+ */
+constexpr int kDefaultHash = 16;
+constexpr int kMaxHash = 1 << 20;
+
+/*
+ * The bounds of the Threads option.
+ */
+constexpr int kMaxThreads = 1024;
+
+/*
+ * The bounds of the MoveOverhead option, in milliseconds.
+ */
+constexpr int kMaxMoveOverhead = 5000;
+
+/*
+ * The bounds of the MultiPV option.
+ */
+constexpr int kMaxMultiPv = int(kMaxMoves);
+
+/*
+ * Held while writing a line, since the search thread writes too.
+ */
+std::mutex output_mutex;
+
+/*
+ * Set up the position given by the arguments of a position command,
+ * "startpos" or "fen <fen>", optionally followed by "moves <moves>".
+ */
+std::unique_ptr<BoardState> parse_position(std::istringstream& arguments){
+	std::string token;
+	arguments >> token;
+	std::string fen;
+	if(token == "startpos"){
+		fen = kStartingPosition;
+		arguments >> token;
+	}else if(token == "fen"){
+		while(arguments >> token && token != "moves"){
+			fen += (fen.empty()?"":" ") + token;
+		}
+	}else{
+		throw "Expected startpos or fen in position command.";
+	}
+	std::unique_ptr<BoardState> result(new BoardState(BoardState::from_fen(fen)));
+	if(token == "moves"){
+		while(arguments >> token){
+			result->make_move(uci_to_move(token));
+		}
+	}
+	return result;
+}
+
+/*
+ * Read the limits of a go command.  Only the clock of the side to move is
+ * kept.  infinite is set if the search is to go on until stop.
+ */
+SearchLimits parse_limits(std::istringstream& arguments, const bool whites_turn,
+		const std::chrono::milliseconds move_overhead, bool& infinite){
+	SearchLimits result;
+	result.move_overhead = move_overhead;
+	infinite = false;
+	std::string token;
+	while(arguments >> token){
+		long long milliseconds = 0;
+		if(token == "infinite"){
+			infinite = true;
+		}else if(token == "depth"){
+			arguments >> result.depth;
+		}else if(token == "nodes"){
+			arguments >> result.nodes;
+		}else if(token == "movestogo"){
+			arguments >> result.moves_to_go;
+		}else if(token == "movetime"){
+			arguments >> milliseconds;
+			result.move_time = std::chrono::milliseconds(milliseconds);
+		}else if(token == (whites_turn?"wtime":"btime")){
+			// A clock that has run out still gets a move.
+			arguments >> milliseconds;
+			result.time = std::chrono::milliseconds(std::max(milliseconds, 1LL));
+		}else if(token == (whites_turn?"winc":"binc")){
+			arguments >> milliseconds;
+			result.increment = std::chrono::milliseconds(milliseconds);
+		}
+	}
+	if(!infinite && result.depth == 0 && result.nodes == 0 && result.time.count() == 0 &&
+			result.move_time.count() == 0){
+		result.depth = kDefaultDepth;
+	}
+	return result;
+}
+
+/*
+ * Print an info line for each root move of an iteration, numbered by
+ * multipv when there is more than one.
+ */
+void print_info(const SearchInfo& info){
+	std::lock_guard<std::mutex> lock(output_mutex);
+	for(std::size_t i = 0; i < info.root_moves.size(); i++){
+		const RootMove& root_move = info.root_moves[i];
+		std::cout << "info depth " << info.depth;
+		if(info.root_moves.size() > 1){
+			std::cout << " multipv " << i + 1;
+		}
+		std::cout << " score ";
+		if(is_mate_score(root_move.score)){
+			const int plies = kMateScore - std::abs(root_move.score);
+			std::cout << "mate " << (root_move.score > 0?(plies + 1) / 2:-(plies / 2));
+		}else{
+			std::cout << "cp " << root_move.score;
+		}
+		std::cout << " nodes " << info.nodes << " nps " << info.nps <<
+				" hashfull " << info.hashfull << " time " << info.time.count() << " pv";
+		for(const Move& move : root_move.pv){
+			std::cout << " " << move_to_uci(move);
+		}
+		std::cout << std::endl;
+	}
+}
+
+/*
+ * Handle "setoption name <name> value <value>".
+ */
+void set_option(std::istringstream& arguments, TranspositionTable& table,
+		ParallelSearcher& searcher, std::chrono::milliseconds& move_overhead){
+	std::string token, name;
+	arguments >> token >> name >> token;
+	if(name == "Hash"){
+		int megabytes = 0;
+		arguments >> megabytes;
+		if(megabytes < 1 || megabytes > kMaxHash){
+			throw "Hash is out of range.";
+		}
+		table.resize(std::size_t(megabytes) << 20, searcher.get_threads());
+	}else if(name == "Threads"){
+		int threads = 0;
+		arguments >> threads;
+		if(threads < 1 || threads > kMaxThreads){
+			throw "Threads is out of range.";
+		}
+		searcher.set_threads(threads);
+	}else if(name == "MoveOverhead"){
+		int milliseconds = -1;
+		arguments >> milliseconds;
+		if(milliseconds < 0 || milliseconds > kMaxMoveOverhead){
+			throw "MoveOverhead is out of range.";
+		}
+		move_overhead = std::chrono::milliseconds(milliseconds);
+	}else if(name == "MultiPV"){
+		int multi_pv = 0;
+		arguments >> multi_pv;
+		if(multi_pv < 1 || multi_pv > kMaxMultiPv){
+			throw "MultiPV is out of range.";
+		}
+		searcher.set_multi_pv(multi_pv);
+	}else if(name == "ParallelMode"){
+		std::string mode;
+		arguments >> mode;
+		if(mode == "lazysmp"){
+			searcher.set_mode(ParallelMode::LAZY_SMP);
+		}else if(mode == "ybwc"){
+			searcher.set_mode(ParallelMode::YBWC);
+		}else{
+			throw "ParallelMode must be lazysmp or ybwc.";
+		}
+	}else{
+		for(const ParameterInfo& info : get_parameter_info()){
+			if(name == info.name){
+				int value = info.min - 1;
+				arguments >> value;
+				if(value < info.min || value > info.max){
+					throw "Search parameter is out of range.";
+				}
+				SearchParameters parameters = searcher.get_parameters();
+				parameters.*info.value = value;
+				searcher.set_parameters(parameters);
+			}
+		}
+	}
+}
+
+} // namespace
+
+int main(){
+	const evallib::MaterialTable material_table;
+	TranspositionTable table(std::size_t(kDefaultHash) << 20);
+	ParallelSearcher searcher(material_table, table);
+	std::unique_ptr<BoardState> board(new BoardState(BoardState::from_fen(kStartingPosition)));
+	std::chrono::milliseconds move_overhead = SearchLimits().move_overhead;
+
+	// The search thread, and whether stop has been sent since it started.
+	// A stop that comes before the search has begun is lost, so the search
+	// thread passes it on again after each iteration.  An infinite search
+	// waits for stop before it answers.
+	std::thread search_thread;
+	std::atomic<bool> stop_requested(false);
+	std::mutex stop_mutex;
+	std::condition_variable stop_condition;
+	auto request_stop = [&](){
+		{
+			std::lock_guard<std::mutex> lock(stop_mutex);
+			stop_requested.store(true);
+		}
+		stop_condition.notify_all();
+		searcher.stop();
+	};
+	// Commands other than stop and isready end any search first, since
+	// they change what it uses.
+	auto end_search = [&](){
+		if(search_thread.joinable()){
+			request_stop();
+			search_thread.join();
+		}
+	};
+	searcher.set_info_callback([&](const SearchInfo& info){
+		print_info(info);
+		if(stop_requested.load()){
+			searcher.stop();
+		}
+	});
 
-int main() {
-	cout << "!!!Hello World!!!" << endl; // prints !!!Hello World!!!
+	std::string line;
+	while(std::getline(std::cin, line)){
+		std::istringstream arguments(line);
+		std::string command;
+		arguments >> command;
+		try{
+			if(command == "uci"){
+				std::lock_guard<std::mutex> lock(output_mutex);
+				std::cout << "id name chessai2" << std::endl;
+				std::cout << "option name Hash type spin default " << kDefaultHash <<
+						" min 1 max " << kMaxHash << std::endl;
+				std::cout << "option name Threads type spin default 1 min 1 max " <<
+						kMaxThreads << std::endl;
+				std::cout << "option name MoveOverhead type spin default " <<
+						move_overhead.count() << " min 0 max " << kMaxMoveOverhead << std::endl;
+				std::cout << "option name MultiPV type spin default 1 min 1 max " <<
+						kMaxMultiPv << std::endl;
+				std::cout << "option name ParallelMode type combo default lazysmp"
+						" var lazysmp var ybwc" << std::endl;
+				const SearchParameters defaults;
+				for(const ParameterInfo& info : get_parameter_info()){
+					std::cout << "option name " << info.name << " type spin default " <<
+							defaults.*info.value << " min " << info.min << " max " <<
+							info.max << std::endl;
+				}
+				std::cout << "uciok" << std::endl;
+			}else if(command == "isready"){
+				std::lock_guard<std::mutex> lock(output_mutex);
+				std::cout << "readyok" << std::endl;
+			}else if(command == "setoption"){
+				end_search();
+				set_option(arguments, table, searcher, move_overhead);
+			}else if(command == "ucinewgame"){
+				end_search();
+				board.reset(new BoardState(BoardState::from_fen(kStartingPosition)));
+				table.clear(searcher.get_threads());
+				searcher.clear_heuristics();
+			}else if(command == "position"){
+				end_search();
+				board = parse_position(arguments);
+			}else if(command == "go"){
+				end_search();
+				bool infinite = false;
+				const SearchLimits limits = parse_limits(arguments, board->get_whites_turn(),
+						move_overhead, infinite);
+				stop_requested.store(false);
+				search_thread = std::thread([&, limits, infinite](){
+					SearchInfo result;
+					try{
+						result = searcher.search(*board, limits);
+					}catch(const char* error){
+						std::lock_guard<std::mutex> lock(output_mutex);
+						std::cout << "info string " << error << std::endl;
+					}
+					if(infinite){
+						std::unique_lock<std::mutex> lock(stop_mutex);
+						stop_condition.wait(lock, [&](){
+							return stop_requested.load();
+						});
+					}
+					std::lock_guard<std::mutex> lock(output_mutex);
+					std::cout << "info string quiescence nodes " << result.quiescence_nodes <<
+							" of " << result.nodes << " first move cutoff rate " <<
+							result.first_move_cutoff_rate << " researches " << result.researches <<
+							" aspiration fail highs " << result.aspiration_fail_highs <<
+							" fail lows " << result.aspiration_fail_lows << std::endl;
+					std::cout << "bestmove " <<
+							(result.pv.empty()?"0000":move_to_uci(result.pv.front())) << std::endl;
+				});
+			}else if(command == "stop"){
+				if(search_thread.joinable()){
+					request_stop();
+				}
+			}else if(command == "quit"){
+				break;
+			}
+		}catch(const char* error){
+			std::lock_guard<std::mutex> lock(output_mutex);
+			std::cout << "info string " << error << std::endl;
+		}
+	}
+	end_search();
 	return 0;
 }
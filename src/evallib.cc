@@ -0,0 +1,432 @@
+/*
+ * evallib.cc
+ *
+ */
+
+#include <evallib.h>
+
+#include <cstdlib>
+
+namespace evallib{
+
+using boardlib::kFull;
+using boardlib::Piece;
+using boardlib::SquareIndex;
+
+/*
+ * Pawn structure weights.  The passed pawn bonus is indexed by the rank
+ * index of the pawn counted from its own side.
+ */
+constexpr Score kDoubledPawn = Score(-10, -25);
+constexpr Score kIsolatedPawn = Score(-5, -15);
+constexpr Score kBackwardPawn = Score(-9, -24);
+constexpr Score kPassedPawn[boardlib::kRanksPerBoard] = {Score(0, 0),
+		Score(5, 10), Score(10, 20), Score(15, 35), Score(30, 60),
+		Score(60, 110), Score(100, 170), Score(0, 0)};
+
+/*
+ * Fill every square on the same file as, and north (south) of, any square
+ * of board, including the squares of board itself.
+ */
+static BitBoard fill_north(const BitBoard board){
+	return BitBoard::slide_north(board, kFull);
+}
+static BitBoard fill_south(const BitBoard board){
+	return BitBoard::slide_south(board, kFull);
+}
+
+/*
+ * Get the squares on the files adjacent to the squares of board.
+ */
+static BitBoard adjacent_files(const BitBoard board){
+	const BitBoard files = fill_north(board) | fill_south(board);
+	return files.step_east() | files.step_west();
+}
+
+/*
+ * Sum the passed pawn bonuses of the given pawns, with ranks counted from
+ * the side of the given color.
+ */
+static Score passed_pawn_score(BitBoard passed, const bool white){
+	Score result;
+	while(passed){
+		const SquareIndex square = passed.pop_least_significant_1_bit().greatest_square_index();
+		const SquareIndex rank = boardlib::rank_index_of(square);
+		result += kPassedPawn[white?rank:(boardlib::kRanksPerBoard - 1 - rank)];
+	}
+	return result;
+}
+
+void evaluate_pawns(const BitBoard white_pawns, const BitBoard black_pawns,
+		PawnEntry& entry){
+	// The squares strictly ahead of each side's pawns on their files.
+	const BitBoard white_front_spans = fill_north(white_pawns.step_north());
+	const BitBoard black_front_spans = fill_south(black_pawns.step_south());
+
+	// A pawn is doubled if it lies behind another pawn of its side.
+	const BitBoard white_doubled = white_pawns & fill_south(white_pawns.step_south());
+	const BitBoard black_doubled = black_pawns & fill_north(black_pawns.step_north());
+
+	// A pawn is passed if it isn't doubled and no enemy pawn's front span,
+	// widened to the adjacent files, covers it.
+	const BitBoard white_passed = white_pawns & ~white_doubled &
+			~(black_front_spans | black_front_spans.step_east() | black_front_spans.step_west());
+	const BitBoard black_passed = black_pawns & ~black_doubled &
+			~(white_front_spans | white_front_spans.step_east() | white_front_spans.step_west());
+
+	const BitBoard white_isolated = white_pawns & ~adjacent_files(white_pawns);
+	const BitBoard black_isolated = black_pawns & ~adjacent_files(black_pawns);
+
+	// A pawn can be supported by a neighbor level with or behind it, so it
+	// is backward if there is none and its stop square is attacked.
+	const BitBoard white_support = fill_north(white_pawns);
+	const BitBoard black_support = fill_south(black_pawns);
+	const BitBoard white_attacks = white_pawns.step_northeast() | white_pawns.step_northwest();
+	const BitBoard black_attacks = black_pawns.step_southeast() | black_pawns.step_southwest();
+	const BitBoard white_backward = white_pawns & ~white_isolated &
+			~(white_support.step_east() | white_support.step_west()) &
+			black_attacks.step_south();
+	const BitBoard black_backward = black_pawns & ~black_isolated &
+			~(black_support.step_east() | black_support.step_west()) &
+			white_attacks.step_north();
+
+	entry.passed = white_passed | black_passed;
+	entry.isolated = white_isolated | black_isolated;
+	entry.doubled = white_doubled | black_doubled;
+	entry.backward = white_backward | black_backward;
+
+	Score score = passed_pawn_score(white_passed, true) -
+			passed_pawn_score(black_passed, false);
+	score += kDoubledPawn * (white_doubled.population_count() - black_doubled.population_count());
+	score += kIsolatedPawn * (white_isolated.population_count() - black_isolated.population_count());
+	score += kBackwardPawn * (white_backward.population_count() - black_backward.population_count());
+	entry.score = score;
+}
+
+PawnHashTable::PawnHashTable(const std::size_t size_in_bytes){
+	std::size_t size = 1;
+	while(2 * size * sizeof(PawnEntry) <= size_in_bytes){
+		size *= 2;
+	}
+	entries_.resize(size);
+	mask_ = size - 1;
+	clear();
+}
+
+const PawnEntry& PawnHashTable::probe(const BoardState& state){
+	const ZobristKey key = state.get_pawn_key();
+	PawnEntry& entry = entries_[key & mask_];
+	probes_++;
+	if(entry.key == key){
+		hits_++;
+		return entry;
+	}
+	evaluate_pawns(state.get_pieces(Piece::WHITE_PAWN),
+			state.get_pieces(Piece::BLACK_PAWN), entry);
+	entry.key = key;
+	return entry;
+}
+
+void PawnHashTable::clear(){
+	// An entry of all zeros is the correct evaluation of the position with
+	// no pawns, whose key is zero, so a cleared table holds no wrong entries.
+	for(PawnEntry& entry : entries_){
+		entry = PawnEntry();
+	}
+	probes_ = 0;
+	hits_ = 0;
+}
+
+std::uint64_t PawnHashTable::get_probes() const{
+	return probes_;
+}
+
+std::uint64_t PawnHashTable::get_hits() const{
+	return hits_;
+}
+
+double PawnHashTable::get_hit_rate() const{
+	return probes_ == 0?0.0:double(hits_) / probes_;
+}
+
+/*
+ * Piece values used to weigh non-pawn material when choosing scale factors.
+ */
+constexpr int kKnightValue = 320;
+constexpr int kBishopValue = 330;
+constexpr int kRookValue = 500;
+constexpr int kQueenValue = 900;
+
+/*
+ * The scale factor for a side without pawns that is ahead by no more than a
+ * minor piece, as in rook against bishop.
+ */
+constexpr int kScaleHard = 16;
+
+/*
+ * Imbalance weights.  Knights gain value and rooks lose it for each of
+ * their own pawns above five.
+ */
+constexpr Score kBishopPair = Score(30, 50);
+constexpr Score kKnightPawnAdjustment = Score(3, 6);
+constexpr Score kRookPawnAdjustment = Score(-6, -12);
+
+/*
+ * The number of values each piece count takes in the material table,
+ * which is the starting number plus one.
+ */
+constexpr int kPawnCounts = 9;
+constexpr int kMinorCounts = 3;
+constexpr int kRookCounts = 3;
+constexpr int kQueenCounts = 2;
+constexpr int kSideConfigurations = kPawnCounts * kMinorCounts * kMinorCounts *
+		kRookCounts * kQueenCounts;
+
+/*
+ * The piece counts of one side.
+ */
+struct SideMaterial{
+	int pawns;
+	int knights;
+	int bishops;
+	int rooks;
+	int queens;
+
+	SideMaterial(const MaterialKey key, const bool white) :
+			pawns(boardlib::count_of(key, white?Piece::WHITE_PAWN:Piece::BLACK_PAWN)),
+			knights(boardlib::count_of(key, white?Piece::WHITE_KNIGHT:Piece::BLACK_KNIGHT)),
+			bishops(boardlib::count_of(key, white?Piece::WHITE_BISHOP:Piece::BLACK_BISHOP)),
+			rooks(boardlib::count_of(key, white?Piece::WHITE_ROOK:Piece::BLACK_ROOK)),
+			queens(boardlib::count_of(key, white?Piece::WHITE_QUEEN:Piece::BLACK_QUEEN)){}
+
+	int non_pawn_material() const{
+		return knights * kKnightValue + bishops * kBishopValue +
+				rooks * kRookValue + queens * kQueenValue;
+	}
+
+	bool bare_king() const{
+		return pawns == 0 && non_pawn_material() == 0;
+	}
+
+	/*
+	 * The index of this side in the material table, or -1 if a count is
+	 * out of range.
+	 */
+	int index() const{
+		if(pawns >= kPawnCounts || knights >= kMinorCounts || bishops >= kMinorCounts ||
+				rooks >= kRookCounts || queens >= kQueenCounts){
+			return -1;
+		}
+		return (((queens * kRookCounts + rooks) * kMinorCounts + bishops) *
+				kMinorCounts + knights) * kPawnCounts + pawns;
+	}
+};
+
+/*
+ * Get the MaterialKey of one side from its index in the material table.
+ */
+static MaterialKey side_key_of(int index, const bool white){
+	using boardlib::material_key_of;
+	MaterialKey result = material_key_of(white?Piece::WHITE_KING:Piece::BLACK_KING);
+	result += (index % kPawnCounts) * material_key_of(white?Piece::WHITE_PAWN:Piece::BLACK_PAWN);
+	index /= kPawnCounts;
+	result += (index % kMinorCounts) * material_key_of(white?Piece::WHITE_KNIGHT:Piece::BLACK_KNIGHT);
+	index /= kMinorCounts;
+	result += (index % kMinorCounts) * material_key_of(white?Piece::WHITE_BISHOP:Piece::BLACK_BISHOP);
+	index /= kMinorCounts;
+	result += (index % kRookCounts) * material_key_of(white?Piece::WHITE_ROOK:Piece::BLACK_ROOK);
+	index /= kRookCounts;
+	result += index * material_key_of(white?Piece::WHITE_QUEEN:Piece::BLACK_QUEEN);
+	return result;
+}
+
+static Score imbalance_of(const SideMaterial& side){
+	Score result;
+	if(side.bishops >= 2){
+		result += kBishopPair;
+	}
+	result += kKnightPawnAdjustment * (side.knights * (side.pawns - 5));
+	result += kRookPawnAdjustment * (side.rooks * (side.pawns - 5));
+	return result;
+}
+
+/*
+ * Get the scale factor for when strong is ahead of weak.
+ */
+static unsigned char scale_of(const SideMaterial& strong, const SideMaterial& weak){
+	if(strong.pawns != 0){
+		return kScaleNormal;
+	}
+	// A single minor piece or two knights can't force mate.
+	if(strong.non_pawn_material() < kRookValue || (strong.bishops == 0 &&
+			strong.rooks == 0 && strong.queens == 0 && strong.knights <= 2)){
+		return kScaleDraw;
+	}
+	if(strong.non_pawn_material() - weak.non_pawn_material() <= kBishopValue){
+		return kScaleHard;
+	}
+	return kScaleNormal;
+}
+
+MaterialEntry evaluate_material(const MaterialKey key){
+	const SideMaterial white(key, true);
+	const SideMaterial black(key, false);
+	MaterialEntry result;
+
+	const int phase = white.knights + white.bishops + 2 * white.rooks + 4 * white.queens +
+			black.knights + black.bishops + 2 * black.rooks + 4 * black.queens;
+	result.phase = phase < kMaxPhase?phase:kMaxPhase;
+	result.imbalance = imbalance_of(white) - imbalance_of(black);
+	result.scale[0] = scale_of(white, black);
+	result.scale[1] = scale_of(black, white);
+
+	result.endgame = Endgame::NONE;
+	if(black.bare_king() && white.pawns == 0 && (white.queens || white.rooks)){
+		result.endgame = Endgame::WHITE_MATES_KING;
+	}else if(white.bare_king() && black.pawns == 0 && (black.queens || black.rooks)){
+		result.endgame = Endgame::BLACK_MATES_KING;
+	}
+	return result;
+}
+
+int blend(const Score score, const MaterialEntry& material){
+	const int value = (score.mg * material.phase +
+			score.eg * (kMaxPhase - material.phase)) / kMaxPhase;
+	return value * material.scale[value > 0?0:1] / kScaleNormal;
+}
+
+/*
+ * Get the distance of a square from the center, from 0 to 3.
+ */
+static int center_distance(const SquareIndex square){
+	const int file = boardlib::file_index_of(square);
+	const int rank = boardlib::rank_index_of(square);
+	const int file_distance = file < 4?3 - file:file - 4;
+	const int rank_distance = rank < 4?3 - rank:rank - 4;
+	return file_distance > rank_distance?file_distance:rank_distance;
+}
+
+/*
+ * Get the number of king moves between two squares.
+ */
+static int king_distance(const SquareIndex a, const SquareIndex b){
+	const int file_distance = std::abs(boardlib::file_index_of(a) - boardlib::file_index_of(b));
+	const int rank_distance = std::abs(boardlib::rank_index_of(a) - boardlib::rank_index_of(b));
+	return file_distance > rank_distance?file_distance:rank_distance;
+}
+
+int evaluate_endgame(const BoardState& state, const MaterialEntry& material){
+	switch(material.endgame){
+	case Endgame::WHITE_MATES_KING:
+	case Endgame::BLACK_MATES_KING:{
+		// Drive the bare king to the edge, with the other king close by.
+		const bool white = material.endgame == Endgame::WHITE_MATES_KING;
+		const SquareIndex strong_king = state.get_pieces(
+				white?Piece::WHITE_KING:Piece::BLACK_KING).greatest_square_index();
+		const SquareIndex weak_king = state.get_pieces(
+				white?Piece::BLACK_KING:Piece::WHITE_KING).greatest_square_index();
+		const int value = kKnownWin + 20 * center_distance(weak_king) +
+				10 * (7 - king_distance(strong_king, weak_king));
+		return white?value:-value;
+	}
+	case Endgame::NONE:
+		break;
+	}
+	throw "No specialized evaluation for this material.";
+}
+
+MaterialTable::MaterialTable(){
+	entries_.resize(kSideConfigurations * kSideConfigurations);
+	for(int white = 0; white < kSideConfigurations; white++){
+		for(int black = 0; black < kSideConfigurations; black++){
+			entries_[white * kSideConfigurations + black] =
+					evaluate_material(side_key_of(white, true) + side_key_of(black, false));
+		}
+	}
+}
+
+int MaterialTable::index_of(const MaterialKey key){
+	const int white = SideMaterial(key, true).index();
+	const int black = SideMaterial(key, false).index();
+	if(white < 0 || black < 0){
+		return -1;
+	}
+	return white * kSideConfigurations + black;
+}
+
+MaterialEntry MaterialTable::probe(const MaterialKey key) const{
+	const int index = index_of(key);
+	return index < 0?evaluate_material(key):entries_[index];
+}
+
+/*
+ * Piece placement weights, per step of distance from the center, and the
+ * middle game bonus for a king on its own back rank.
+ */
+constexpr Score kKnightCenterDistance = Score(-10, -8);
+constexpr Score kBishopCenterDistance = Score(-5, -5);
+constexpr Score kRookCenterDistance = Score(-2, 0);
+constexpr Score kQueenCenterDistance = Score(-2, -5);
+constexpr Score kKingCenterDistance = Score(0, -12);
+constexpr Score kKingBackRank = Score(20, 0);
+
+/*
+ * Sum the material and placement scores of the pieces on board.
+ */
+static Score placement_score(BitBoard board, const Score value, const Score center_weight){
+	Score result;
+	while(board){
+		const SquareIndex square = board.pop_least_significant_1_bit().greatest_square_index();
+		result += value + center_weight * center_distance(square);
+	}
+	return result;
+}
+
+/*
+ * Score the pieces of one side.
+ */
+static Score side_score(const BoardState& state, const bool white){
+	Score result;
+	result += kPawnScore * state.get_pieces(
+			white?Piece::WHITE_PAWN:Piece::BLACK_PAWN).population_count();
+	result += placement_score(state.get_pieces(white?Piece::WHITE_KNIGHT:Piece::BLACK_KNIGHT),
+			kKnightScore, kKnightCenterDistance);
+	result += placement_score(state.get_pieces(white?Piece::WHITE_BISHOP:Piece::BLACK_BISHOP),
+			kBishopScore, kBishopCenterDistance);
+	result += placement_score(state.get_pieces(white?Piece::WHITE_ROOK:Piece::BLACK_ROOK),
+			kRookScore, kRookCenterDistance);
+	result += placement_score(state.get_pieces(white?Piece::WHITE_QUEEN:Piece::BLACK_QUEEN),
+			kQueenScore, kQueenCenterDistance);
+	const BitBoard king = state.get_pieces(white?Piece::WHITE_KING:Piece::BLACK_KING);
+	result += placement_score(king, Score(), kKingCenterDistance);
+	if(king & (white?boardlib::kRank1:boardlib::kRank8)){
+		result += kKingBackRank;
+	}
+	return result;
+}
+
+Score evaluate_pieces(const BoardState& state){
+	return side_score(state, true) - side_score(state, false);
+}
+
+Evaluator::Evaluator(const MaterialTable& material_table, const std::size_t pawn_table_size) :
+		material_table_(material_table), pawn_table_(pawn_table_size){}
+
+int Evaluator::evaluate(const BoardState& state){
+	const MaterialEntry material = material_table_.probe(state.get_material_key());
+	int value;
+	if(material.endgame != Endgame::NONE){
+		value = evaluate_endgame(state, material);
+	}else{
+		const Score score = material.imbalance + pawn_table_.probe(state).score +
+				evaluate_pieces(state);
+		value = blend(score, material);
+	}
+	return state.get_whites_turn()?value:-value;
+}
+
+const PawnHashTable& Evaluator::get_pawn_table() const{
+	return pawn_table_;
+}
+
+} // namespace evallib
@@ -0,0 +1,1561 @@
+/*
+ * searchlib.cc
+ *
+ */
+
+#include <searchlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace searchlib{
+
+using boardlib::BitBoard;
+using boardlib::MoveRecord;
+using boardlib::PieceKind;
+using boardlib::SearchPolicy;
+
+PvTable::PvTable(){
+	std::fill(lengths_, lengths_ + kMaxPly, 0);
+}
+
+void PvTable::update(const int ply, const Move& move){
+	moves_[ply][ply] = move;
+	const int length = ply + 1 < kMaxPly?lengths_[ply + 1]:0;
+	for(int i = ply + 1; i < length; i++){
+		moves_[ply][i] = moves_[ply + 1][i];
+	}
+	lengths_[ply] = std::max(length, ply + 1);
+}
+
+std::vector<Move> PvTable::line(const int ply) const{
+	if(lengths_[ply] <= ply){
+		return std::vector<Move>();
+	}
+	return std::vector<Move>(moves_[ply] + ply, moves_[ply] + lengths_[ply]);
+}
+
+void PvTable::set_line(const int ply, const std::vector<Move>& line){
+	const int length = std::min<int>(line.size(), kMaxPly - ply);
+	std::copy(line.begin(), line.begin() + length, moves_[ply] + ply);
+	lengths_[ply] = ply + length;
+}
+
+/*
+ * The layout of the data word of a transposition table entry.
+ */
+constexpr int kScoreShift = 16;
+constexpr int kDepthShift = 32;
+constexpr int kBoundShift = 40;
+constexpr int kGenerationShift = 42;
+constexpr unsigned kGenerationCount = 64;
+
+static std::uint64_t pack_entry(const Move& move, const int score, const int depth,
+		const Bound bound, const unsigned generation){
+	return std::uint64_t(pack_move(move)) |
+			(std::uint64_t(std::uint16_t(score)) << kScoreShift) |
+			(std::uint64_t(std::uint8_t(depth)) << kDepthShift) |
+			(std::uint64_t(bound) << kBoundShift) |
+			(std::uint64_t(generation) << kGenerationShift);
+}
+
+static TableEntry unpack_entry(const std::uint64_t data){
+	TableEntry result;
+	result.move = unpack_move(std::uint16_t(data));
+	result.score = std::int16_t(data >> kScoreShift);
+	result.depth = std::int8_t(data >> kDepthShift);
+	result.bound = static_cast<Bound>((data >> kBoundShift) & 3);
+	return result;
+}
+
+static unsigned generation_of(const std::uint64_t data){
+	return (data >> kGenerationShift) & (kGenerationCount - 1);
+}
+
+/*
+ * Huge pages are 2 MiB on the platforms that have transparent ones.
+ */
+constexpr std::size_t kHugePageSize = std::size_t(1) << 21;
+
+TranspositionTable::TranspositionTable(const std::size_t size_in_bytes, const unsigned threads) :
+		clusters_(nullptr), cluster_count_(0), generation_(0){
+	resize(size_in_bytes, threads);
+}
+
+TranspositionTable::~TranspositionTable(){
+	std::free(clusters_);
+}
+
+void TranspositionTable::resize(const std::size_t size_in_bytes, const unsigned threads){
+	std::size_t cluster_count = 1;
+	while(cluster_count * sizeof(Cluster) <= size_in_bytes / 2){
+		cluster_count *= 2;
+	}
+
+	// Sizes are powers of two, so a table of at least a huge page is a
+	// multiple of one, as aligned_alloc requires.  The old table is only
+	// freed once the new one is allocated, so that a failed resize leaves
+	// it in use.
+	const std::size_t size = cluster_count * sizeof(Cluster);
+	const std::size_t alignment = size >= kHugePageSize?kHugePageSize:sizeof(Cluster);
+	// No object may be larger than the largest pointer difference.
+	void* memory = size > std::size_t(std::numeric_limits<std::ptrdiff_t>::max())?nullptr:
+			std::aligned_alloc(alignment, size);
+	if(memory == nullptr){
+		throw "Unable to allocate the transposition table.";
+	}
+#ifdef MADV_HUGEPAGE
+	if(alignment == kHugePageSize){
+		madvise(memory, size, MADV_HUGEPAGE);
+	}
+#endif
+	std::free(clusters_);
+	clusters_ = static_cast<Cluster*>(memory);
+	cluster_count_ = cluster_count;
+	clear(threads);
+}
+
+void TranspositionTable::clear(const unsigned threads){
+	// Touching the pages here, spread over threads, also spreads their
+	// first-touch allocation over the threads' memory nodes.
+	const std::size_t thread_count = std::max(1u, std::min<unsigned>(threads, cluster_count_));
+	const std::size_t chunk = (cluster_count_ + thread_count - 1) / thread_count;
+	auto clear_chunk = [this, chunk](const std::size_t i){
+		const std::size_t begin = i * chunk;
+		const std::size_t end = std::min(begin + chunk, cluster_count_);
+		if(begin < end){
+			std::memset(static_cast<void*>(clusters_ + begin), 0, (end - begin) * sizeof(Cluster));
+		}
+	};
+	std::vector<std::thread> workers;
+	for(std::size_t i = 1; i < thread_count; i++){
+		workers.emplace_back(clear_chunk, i);
+	}
+	clear_chunk(0);
+	for(std::thread& worker : workers){
+		worker.join();
+	}
+	generation_.store(0, std::memory_order_relaxed);
+}
+
+void TranspositionTable::new_search(){
+	generation_.store((generation_.load(std::memory_order_relaxed) + 1) % kGenerationCount,
+			std::memory_order_relaxed);
+}
+
+bool TranspositionTable::probe(const ZobristKey key, TableEntry& entry) const{
+	const Cluster& cluster = cluster_of(key);
+	for(std::size_t i = 0; i < kClusterSize; i++){
+		const std::uint64_t check = cluster.words[2 * i].load(std::memory_order_relaxed);
+		const std::uint64_t data = cluster.words[2 * i + 1].load(std::memory_order_relaxed);
+		if((check ^ data) == key && data != 0){
+			entry = unpack_entry(data);
+			return true;
+		}
+	}
+	return false;
+}
+
+void TranspositionTable::store(const ZobristKey key, const Move& move, const int score,
+		const int depth, const Bound bound){
+	Cluster& cluster = cluster_of(key);
+	const unsigned generation = generation_.load(std::memory_order_relaxed);
+	std::size_t replace = 0;
+	int least_worth = kInfinity;
+	std::uint64_t replaced_data = 0;
+	for(std::size_t i = 0; i < kClusterSize; i++){
+		const std::uint64_t check = cluster.words[2 * i].load(std::memory_order_relaxed);
+		const std::uint64_t data = cluster.words[2 * i + 1].load(std::memory_order_relaxed);
+		if((check ^ data) == key && data != 0){
+			replace = i;
+			replaced_data = data;
+			break;
+		}
+		const unsigned age = (generation + kGenerationCount - generation_of(data)) %
+				kGenerationCount;
+		const int worth = data == 0?-kInfinity:
+				int(std::int8_t(data >> kDepthShift)) - kAgeWeight * int(age);
+		if(worth < least_worth){
+			least_worth = worth;
+			replace = i;
+		}
+	}
+
+	Move stored_move = move;
+	if(replaced_data != 0){
+		const TableEntry old = unpack_entry(replaced_data);
+		// Keep a deeper result from this search unless the new one is exact.
+		if(bound != Bound::EXACT && generation_of(replaced_data) == generation &&
+				old.depth > depth + 2){
+			return;
+		}
+		if(move == boardlib::kNoMove){
+			stored_move = old.move;
+		}
+	}
+	const std::uint64_t data = pack_entry(stored_move, score, depth, bound, generation);
+	cluster.words[2 * replace + 1].store(data, std::memory_order_relaxed);
+	cluster.words[2 * replace].store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::prefetch_hook(const void* context, const ZobristKey key){
+	static_cast<const TranspositionTable*>(context)->prefetch(key);
+}
+
+int TranspositionTable::get_hashfull() const{
+	const std::size_t sample = std::min<std::size_t>(1000, cluster_count_);
+	const unsigned generation = generation_.load(std::memory_order_relaxed);
+	std::size_t used = 0;
+	for(std::size_t i = 0; i < sample; i++){
+		for(std::size_t j = 0; j < kClusterSize; j++){
+			const std::uint64_t data = clusters_[i].words[2 * j + 1].load(std::memory_order_relaxed);
+			used += data != 0 && generation_of(data) == generation;
+		}
+	}
+	return int(used * 1000 / (sample * kClusterSize));
+}
+
+std::size_t TranspositionTable::get_size_in_bytes() const{
+	return cluster_count_ * sizeof(Cluster);
+}
+
+/*
+ * Rough piece values for ordering captures, indexed by PieceKind.  The king
+ * only ever attacks, and is the least desirable attacker.
+ */
+constexpr int kOrderValues[] = {0, 20, 9, 3, 3, 5, 1};
+
+/*
+ * Ordering scores.  The previous principal variation comes first, then the
+ * transposition table move, then captures and promotions by most valuable
+ * victim and least valuable attacker, then the killers and the
+ * countermove, then quiet moves by history, which is less than 1 << 17 in
+ * magnitude.
+ */
+constexpr int kPvMoveScore = 1 << 30;
+constexpr int kTableMoveScore = 1 << 29;
+constexpr int kCaptureScore = 1 << 28;
+constexpr int kKillerScore = 1 << 27;
+constexpr int kCounterMoveScore = 1 << 26;
+
+/*
+ * The bound of history scores, and the largest change of one update.
+ */
+constexpr int kHistoryMax = 1 << 14;
+constexpr int kMaxHistoryBonus = 1200;
+
+/*
+ * Move entry towards +-kHistoryMax by bonus, less the closer it is.
+ */
+static void update_history(std::int16_t& entry, const int bonus){
+	entry += bonus - entry * std::abs(bonus) / kHistoryMax;
+}
+
+static unsigned index_of(const Piece piece){
+	return static_cast<unsigned char>(piece);
+}
+
+static int order_value_of(const Piece piece){
+	return kOrderValues[static_cast<unsigned char>(boardlib::kind_of(piece))];
+}
+
+/*
+ * Material values for static exchange evaluation, indexed by PieceKind.
+ * They are the middle game values of evaluation, and the king is worth
+ * more than everything else together.
+ */
+constexpr int kSeeValues[] = {0, 20000, evallib::kQueenScore.mg, evallib::kBishopScore.mg,
+		evallib::kKnightScore.mg, evallib::kRookScore.mg, evallib::kPawnScore.mg};
+
+/*
+ * Attackers are tried in this order, least valuable first.
+ */
+constexpr PieceKind kSeeOrder[] = {PieceKind::PAWN, PieceKind::KNIGHT, PieceKind::BISHOP,
+		PieceKind::ROOK, PieceKind::QUEEN, PieceKind::KING};
+
+static int see_value_of(const Piece piece){
+	return kSeeValues[static_cast<unsigned char>(boardlib::kind_of(piece))];
+}
+
+/*
+ * Return the piece that move captures, which for en passant is not on its
+ * destination, or NO_PIECE.
+ */
+static Piece captured_by(const BoardState& state, const Move& move){
+	const Piece victim = state.get_piece_at(move.to_square);
+	if(victim == Piece::NO_PIECE && move.to_square == state.get_en_passant_square() &&
+			boardlib::kind_of(state.get_piece_at(move.from_square)) == PieceKind::PAWN){
+		return state.get_whites_turn()?Piece::BLACK_PAWN:Piece::WHITE_PAWN;
+	}
+	return victim;
+}
+
+static bool is_quiet(const BoardState& state, const Move& move){
+	return captured_by(state, move) == Piece::NO_PIECE && move.promotion == Piece::NO_PIECE;
+}
+
+/*
+ * Return the material of the pieces other than pawns and the king of
+ * color.
+ */
+static int non_pawn_material(const BoardState& state, const boardlib::Color color){
+	int result = 0;
+	for(const PieceKind kind : {PieceKind::QUEEN, PieceKind::ROOK, PieceKind::BISHOP,
+			PieceKind::KNIGHT}){
+		result += kSeeValues[static_cast<unsigned char>(kind)] *
+				state.get_pieces(boardlib::make_piece(color, kind)).population_count();
+	}
+	return result;
+}
+
+int see(const BoardState& state, const Move& move){
+	const SquareIndex to = move.to_square;
+	const Piece mover = state.get_piece_at(move.from_square);
+	BitBoard occupied = state.get_occupied() ^ BitBoard::from_square_index(move.from_square);
+	const Piece victim = captured_by(state, move);
+	if(victim != Piece::NO_PIECE && state.get_piece_at(to) == Piece::NO_PIECE){
+		// En passant removes a pawn beside the destination.
+		occupied ^= BitBoard::from_square_index(to + (move.to_square > move.from_square?-8:8));
+	}
+
+	// gains[i] is what the side making the i-th capture gains, assuming
+	// that the exchange stops after it.
+	int gains[32];
+	gains[0] = see_value_of(victim);
+	Piece on_square = mover;
+	if(move.promotion != Piece::NO_PIECE){
+		gains[0] += see_value_of(move.promotion) - kSeeValues[static_cast<unsigned char>(PieceKind::PAWN)];
+		on_square = move.promotion;
+	}
+	bool white = !state.get_whites_turn();
+	int depth = 0;
+	while(depth + 1 < 32){
+		const BitBoard attackers = state.get_attackers(to, white, occupied);
+		if(!attackers){
+			break;
+		}
+		const boardlib::Color color = white?boardlib::Color::WHITE:boardlib::Color::BLACK;
+		BitBoard attacker;
+		PieceKind kind = PieceKind::KING;
+		for(const PieceKind candidate : kSeeOrder){
+			attacker = attackers & state.get_pieces(boardlib::make_piece(color, candidate));
+			if(attacker){
+				kind = candidate;
+				break;
+			}
+		}
+		// The king can only take if the square is no longer defended.
+		if(kind == PieceKind::KING && state.get_attackers(to, !white, occupied)){
+			break;
+		}
+		depth++;
+		gains[depth] = see_value_of(on_square) - gains[depth - 1];
+		occupied ^= BitBoard::from_square_index(attacker.greatest_square_index());
+		on_square = boardlib::make_piece(color, kind);
+		white = !white;
+	}
+	// Each side stops the exchange where continuing would lose.
+	for(; depth > 0; depth--){
+		gains[depth - 1] = -std::max(-gains[depth - 1], gains[depth]);
+	}
+	return gains[0];
+}
+
+/*
+ * The most a capture can gain beyond the material it takes, by improving
+ * the position.  Captures that cannot reach alpha even with it are pruned.
+ */
+constexpr int kDeltaMargin = 200;
+
+const std::vector<ParameterInfo>& get_parameter_info(){
+	static const std::vector<ParameterInfo> kParameterInfo = {
+			{"AspirationMinDepth", &SearchParameters::aspiration_min_depth, 1, kMaxPly},
+			{"AspirationWindow", &SearchParameters::aspiration_window, 1, 1000},
+			{"AspirationGrowth", &SearchParameters::aspiration_growth, 0, 400},
+			{"NullMove", &SearchParameters::null_move, 0, 1},
+			{"NullMoveMinDepth", &SearchParameters::null_move_min_depth, 1, 20},
+			{"NullMoveReduction", &SearchParameters::null_move_reduction, 0, 10},
+			{"NullMoveDepthDivisor", &SearchParameters::null_move_depth_divisor, 1, 20},
+			{"NullMoveEvalDivisor", &SearchParameters::null_move_eval_divisor, 1, 1000},
+			{"NullMoveVerifyMaterial", &SearchParameters::null_move_verify_material, 0, 10000},
+			{"LateMoveReductions", &SearchParameters::late_move_reductions, 0, 1},
+			{"LmrMinDepth", &SearchParameters::lmr_min_depth, 1, 20},
+			{"LmrMinMoves", &SearchParameters::lmr_min_moves, 1, 64},
+			{"LmrBase", &SearchParameters::lmr_base, -200, 400},
+			{"LmrDivisor", &SearchParameters::lmr_divisor, 50, 1000},
+			{"ReverseFutility", &SearchParameters::reverse_futility, 0, 1},
+			{"ReverseFutilityMaxDepth", &SearchParameters::reverse_futility_max_depth, 0, 20},
+			{"ReverseFutilityMargin", &SearchParameters::reverse_futility_margin, 0, 1000},
+			{"Futility", &SearchParameters::futility, 0, 1},
+			{"FutilityMaxDepth", &SearchParameters::futility_max_depth, 0, 20},
+			{"FutilityMargin", &SearchParameters::futility_margin, 0, 1000},
+			{"LateMovePruning", &SearchParameters::late_move_pruning, 0, 1},
+			{"LateMovePruningMaxDepth", &SearchParameters::late_move_pruning_max_depth, 0, 20},
+			{"LateMovePruningBase", &SearchParameters::late_move_pruning_base, 0, 64},
+	};
+	return kParameterInfo;
+}
+
+/*
+ * The shallowest depth at which a node is split.  Below it, the subtrees
+ * are too small to pay for the snapshot and the handoff.
+ */
+constexpr int kMinSplitDepth = 4;
+
+WorkPool::WorkPool(const unsigned threads) : idle_(0){
+	for(unsigned i = 0; i < threads; i++){
+		queues_.emplace_back(new Queue());
+	}
+}
+
+void WorkPool::push(const unsigned thread, const SplitTask& task){
+	Queue& queue = *queues_[thread];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	queue.tasks.push_back(task);
+}
+
+bool WorkPool::take(const unsigned thread, SplitTask& task, const SplitPoint* within){
+	for(std::size_t i = 0; i < queues_.size(); i++){
+		const bool own = i == 0;
+		Queue& queue = *queues_[(thread + i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(queue.tasks.empty()){
+			continue;
+		}
+		const SplitTask& candidate = own?queue.tasks.back():queue.tasks.front();
+		if(within != nullptr && !candidate.split_point->is_within(within)){
+			continue;
+		}
+		task = candidate;
+		if(own){
+			queue.tasks.pop_back();
+		}else{
+			queue.tasks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * The nodes searched between reads of the clock for the hard time limit.
+ */
+constexpr std::uint64_t kClockInterval = 1024;
+
+/*
+ * The number of moves the time left is shared between when there is no
+ * moves_to_go, and the share of the increment added to each move.
+ */
+constexpr int kDefaultMovesToGo = 30;
+constexpr double kIncrementShare = 0.75;
+
+/*
+ * The hard limit is at most kHardLimitScale times the soft limit, and at
+ * most kMaxTimeShare of the time left, or kLastMoveTimeShare of it on the
+ * last move before the time control.
+ */
+constexpr double kHardLimitScale = 5;
+constexpr double kMaxTimeShare = 0.5;
+constexpr double kLastMoveTimeShare = 0.9;
+
+/*
+ * Scaling of the soft limit.  Each recent change of the best move adds
+ * kBestMoveChangeScale, a best move that has held for kStableIterations
+ * iterations scales it by kStableScale, and a score drop adds up to
+ * kScoreDropScale, in full at kScoreDropMax centipawns.
+ */
+constexpr double kBestMoveChangeScale = 0.6;
+constexpr int kStableIterations = 4;
+constexpr double kStableScale = 0.7;
+constexpr double kScoreDropScale = 0.5;
+constexpr int kScoreDropMax = 100;
+
+/*
+ * The bounds of the branching factor used for prediction, and how far
+ * past the soft limit the next iteration may be predicted to finish.
+ */
+constexpr double kMinBranchingFactor = 1.5;
+constexpr double kMaxBranchingFactor = 10;
+constexpr double kSoftLimitOverrun = 2;
+
+TimeManager::TimeManager(const SearchLimits& limits) :
+		enabled_(limits.time.count() > 0 || limits.move_time.count() > 0),
+		fixed_(limits.move_time.count() > 0), base_soft_limit_(0), hard_limit_(0), scale_(1),
+		iterations_(0), best_move_(boardlib::kNoMove), score_(0), best_move_changes_(0),
+		stable_iterations_(0), nodes_(0), last_iteration_nodes_(0), branching_factor_(0),
+		elapsed_(0){
+	const Duration minimum(1);
+	if(fixed_){
+		hard_limit_ = std::max(Duration(limits.move_time - limits.move_overhead), minimum);
+		base_soft_limit_ = hard_limit_;
+	}else if(enabled_){
+		const Duration available = std::max(Duration(limits.time - limits.move_overhead),
+				minimum);
+		const int moves_to_go = limits.moves_to_go > 0?limits.moves_to_go:kDefaultMovesToGo;
+		const Duration soft = available / moves_to_go +
+				Duration(limits.increment) * kIncrementShare;
+		hard_limit_ = std::max(std::min(soft * kHardLimitScale,
+				available * (moves_to_go == 1?kLastMoveTimeShare:kMaxTimeShare)), minimum);
+		base_soft_limit_ = std::min(soft, hard_limit_);
+	}
+}
+
+bool TimeManager::is_enabled() const{
+	return enabled_;
+}
+
+TimeManager::Duration TimeManager::get_soft_limit() const{
+	return std::min(base_soft_limit_ * scale_, hard_limit_);
+}
+
+TimeManager::Duration TimeManager::get_hard_limit() const{
+	return hard_limit_;
+}
+
+void TimeManager::update(const Move& best_move, const int score, const std::uint64_t nodes,
+		const Duration elapsed){
+	const std::uint64_t iteration_nodes = nodes - nodes_;
+	if(iterations_ > 0){
+		const bool changed = !(best_move == best_move_);
+		best_move_changes_ = best_move_changes_ / 2 + (changed?1:0);
+		stable_iterations_ = changed?0:stable_iterations_ + 1;
+		double move_scale = 1 + kBestMoveChangeScale * best_move_changes_;
+		if(stable_iterations_ >= kStableIterations){
+			move_scale *= kStableScale;
+		}
+		const int drop = std::min(std::max(score_ - score, 0), kScoreDropMax);
+		scale_ = move_scale * (1 + kScoreDropScale * drop / kScoreDropMax);
+	}
+	if(last_iteration_nodes_ > 0){
+		// Average over two iterations, since odd and even depths differ.
+		const double factor = std::min(std::max(double(iteration_nodes) / last_iteration_nodes_,
+				kMinBranchingFactor), kMaxBranchingFactor);
+		branching_factor_ = branching_factor_ == 0?factor:(branching_factor_ + factor) / 2;
+	}
+	iterations_++;
+	best_move_ = best_move;
+	score_ = score;
+	nodes_ = nodes;
+	last_iteration_nodes_ = iteration_nodes;
+	elapsed_ = elapsed;
+}
+
+TimeManager::Duration TimeManager::predict_next_iteration() const{
+	if(branching_factor_ == 0 || nodes_ == 0){
+		return Duration(0);
+	}
+	const double nodes_per_millisecond = nodes_ / std::max(elapsed_.count(), 1e-3);
+	return Duration(last_iteration_nodes_ * branching_factor_ / nodes_per_millisecond);
+}
+
+bool TimeManager::should_stop() const{
+	if(!enabled_){
+		return false;
+	}
+	const Duration soft_limit = get_soft_limit();
+	const Duration finish = elapsed_ + predict_next_iteration();
+	return elapsed_ >= soft_limit || finish > hard_limit_ ||
+			finish > soft_limit * kSoftLimitOverrun;
+}
+
+Searcher::Searcher(const evallib::MaterialTable& material_table, TranspositionTable& table,
+		const std::size_t pawn_table_size) :
+		evaluator_(material_table, pawn_table_size), table_(table),
+		continuation_(new ContinuationHistory()), thread_index_(0), stop_flag_(nullptr),
+		work_pool_(nullptr), split_point_(nullptr), has_deadline_(false), next_clock_check_(0),
+		root_depth_(0), follow_pv_(false), aborted_(false), nodes_(0), table_probes_(0),
+		table_hits_(0), quiescence_nodes_(0), cutoffs_(0), first_move_cutoffs_(0),
+		null_move_min_ply_(0), researches_(0), aspiration_fail_highs_(0),
+		aspiration_fail_lows_(0), multi_pv_(1){
+	std::fill(ply_nodes_, ply_nodes_ + kMaxPly, 0);
+	clear_heuristics();
+	set_parameters(SearchParameters());
+}
+
+void Searcher::clear_heuristics(){
+	std::fill(&killers_[0][0], &killers_[0][0] + kMaxPly * 2, boardlib::kNoMove);
+	std::memset(history_, 0, sizeof(history_));
+	std::fill(&countermoves_[0][0],
+			&countermoves_[0][0] + boardlib::kPieceEncodings * boardlib::kSquaresPerBoard,
+			boardlib::kNoMove);
+	std::memset(continuation_.get(), 0, sizeof(ContinuationHistory));
+}
+
+void Searcher::set_info_callback(InfoCallback callback){
+	info_callback_ = std::move(callback);
+}
+
+void Searcher::set_thread_index(const unsigned index){
+	thread_index_ = index;
+}
+
+void Searcher::set_stop_flag(const std::atomic<bool>* flag){
+	stop_flag_ = flag;
+}
+
+void Searcher::set_work_pool(WorkPool* pool){
+	work_pool_ = pool;
+}
+
+void Searcher::set_parameters(const SearchParameters& parameters){
+	parameters_ = parameters;
+	for(int depth = 0; depth < kMaxPly; depth++){
+		for(std::size_t index = 0; index < boardlib::kMaxMoves; index++){
+			const double reduction = depth == 0 || index == 0?0:
+					(parameters.lmr_base + std::log(depth) * std::log(index) * 100 *
+					100 / parameters.lmr_divisor) / 100;
+			reductions_[depth][index] = std::max(0, std::min(int(reduction), 255));
+		}
+	}
+}
+
+const SearchParameters& Searcher::get_parameters() const{
+	return parameters_;
+}
+
+void Searcher::set_multi_pv(const unsigned multi_pv){
+	multi_pv_ = std::max(multi_pv, 1u);
+}
+
+unsigned Searcher::get_multi_pv() const{
+	return multi_pv_;
+}
+
+std::uint64_t Searcher::get_nodes() const{
+	return nodes_.load(std::memory_order_relaxed);
+}
+
+/*
+ * The iteration schedules of helper threads.  Helper i skips blocks of
+ * kSkipSize[j] iterations in every other block, with the blocks shifted by
+ * kSkipPhase[j], where j is (i - 1) modulo the number of schedules.
+ */
+constexpr int kSkipSize[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int kSkipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+constexpr unsigned kSkipSchedules = sizeof(kSkipSize) / sizeof(kSkipSize[0]);
+
+bool Searcher::skips_depth(const int depth) const{
+	if(thread_index_ == 0 || depth == 1){
+		return false;
+	}
+	const unsigned schedule = (thread_index_ - 1) % kSkipSchedules;
+	return ((depth + kSkipPhase[schedule]) / kSkipSize[schedule]) % 2 != 0;
+}
+
+void Searcher::order_moves(const BoardState& state, MoveList& moves, const int ply,
+		const Move& table_move){
+	const Move pv_move = follow_pv_ && ply < int(previous_pv_.size())?
+			previous_pv_[ply]:boardlib::kNoMove;
+	const PieceTo previous = previous_move(ply, 1);
+	const Move counter_move = previous.piece != Piece::NO_PIECE?
+			countermoves_[index_of(previous.piece)][previous.square]:boardlib::kNoMove;
+	int scores[boardlib::kMaxMoves];
+	bool found_pv_move = false;
+	for(std::size_t i = 0; i < moves.size; i++){
+		const Move& move = moves[i];
+		if(move == pv_move){
+			scores[i] = kPvMoveScore;
+			found_pv_move = true;
+			continue;
+		}
+		if(move == table_move){
+			scores[i] = kTableMoveScore;
+			continue;
+		}
+		const Piece piece = state.get_piece_at(move.from_square);
+		const Piece victim = captured_by(state, move);
+		const int promotion = order_value_of(move.promotion);
+		if(victim != Piece::NO_PIECE || promotion != 0){
+			scores[i] = kCaptureScore + 16 * (order_value_of(victim) + promotion) -
+					order_value_of(piece);
+		}else if(move == killers_[ply][0]){
+			scores[i] = kKillerScore + 1;
+		}else if(move == killers_[ply][1]){
+			scores[i] = kKillerScore;
+		}else if(move == counter_move){
+			scores[i] = kCounterMoveScore;
+		}else{
+			scores[i] = history_score(state, ply, piece, move);
+		}
+	}
+	// Stop following the principal variation once search leaves it.
+	follow_pv_ = found_pv_move;
+
+	// Insertion sort, stable so that generation order breaks ties.
+	for(std::size_t i = 1; i < moves.size; i++){
+		const Move move = moves[i];
+		const int score = scores[i];
+		std::size_t j = i;
+		for(; j > 0 && scores[j - 1] < score; j--){
+			moves.moves[j] = moves.moves[j - 1];
+			scores[j] = scores[j - 1];
+		}
+		moves.moves[j] = move;
+		scores[j] = score;
+	}
+}
+
+int Searcher::history_score(const BoardState& state, const int ply, const Piece piece,
+		const Move& move) const{
+	int score = history_[state.get_whites_turn()][move.from_square][move.to_square];
+	for(int plies_ago = 1; plies_ago <= 2; plies_ago++){
+		const PieceTo previous = previous_move(ply, plies_ago);
+		if(previous.piece != Piece::NO_PIECE){
+			score += continuation_->scores[index_of(previous.piece)][previous.square]
+					[index_of(piece)][move.to_square];
+		}
+	}
+	return score;
+}
+
+void Searcher::update_heuristics(const BoardState& state, const int ply, const int depth,
+		const Move& move, const Move* tried, const std::size_t tried_count){
+	if(!(killers_[ply][0] == move)){
+		killers_[ply][1] = killers_[ply][0];
+		killers_[ply][0] = move;
+	}
+	const PieceTo previous = previous_move(ply, 1);
+	if(previous.piece != Piece::NO_PIECE){
+		countermoves_[index_of(previous.piece)][previous.square] = move;
+	}
+
+	// Reward the move, and penalize the ones that failed before it.
+	const int bonus = std::min(16 * depth * depth, kMaxHistoryBonus);
+	const bool white = state.get_whites_turn();
+	auto update = [&](const Move& quiet, const int change){
+		update_history(history_[white][quiet.from_square][quiet.to_square], change);
+		const unsigned piece = index_of(state.get_piece_at(quiet.from_square));
+		for(int plies_ago = 1; plies_ago <= 2; plies_ago++){
+			const PieceTo before = previous_move(ply, plies_ago);
+			if(before.piece != Piece::NO_PIECE){
+				update_history(continuation_->scores[index_of(before.piece)][before.square]
+						[piece][quiet.to_square], change);
+			}
+		}
+	};
+	update(move, bonus);
+	for(std::size_t i = 0; i < tried_count; i++){
+		if(!(tried[i] == move)){
+			update(tried[i], -bonus);
+		}
+	}
+}
+
+bool Searcher::should_abort(){
+	// The first iteration of thread 0 always completes.
+	const std::uint64_t nodes = get_nodes();
+	if(root_depth_ <= 1 && thread_index_ == 0){
+		return aborted_;
+	}
+	if((limits_.nodes != 0 && nodes >= limits_.nodes) ||
+			(stop_flag_ != nullptr && stop_flag_->load(std::memory_order_relaxed))){
+		aborted_ = true;
+	}else if(has_deadline_ && nodes >= next_clock_check_){
+		next_clock_check_ = nodes + kClockInterval;
+		aborted_ = aborted_ || std::chrono::steady_clock::now() >= deadline_;
+	}
+	return aborted_;
+}
+
+int Searcher::negamax(BoardState& state, const int depth, const int ply, int alpha,
+		const int beta){
+	if(depth <= 0){
+		return quiescence(state, ply, alpha, beta);
+	}
+	count_node(ply);
+	pv_table_.clear(ply);
+	if(ply > 0 && state.is_draw(2)){
+		return 0;
+	}
+	if(ply >= kMaxPly - 1){
+		return evaluator_.evaluate(state);
+	}
+
+	// Below the root, a deep enough stored result can decide the node, but
+	// not on the principal variation, whose moves the table doesn't keep.
+	const bool pv_node = beta - alpha > 1;
+	const ZobristKey key = state.get_hash();
+	TableEntry entry;
+	table_probes_++;
+	const bool hit = table_.probe(key, entry);
+	if(hit){
+		table_hits_++;
+		if(!pv_node && ply > 0 && entry.depth >= depth){
+			const int score = score_from_table(entry.score, ply);
+			if(entry.bound == Bound::EXACT ||
+					(entry.bound == Bound::LOWER && score >= beta) ||
+					(entry.bound == Bound::UPPER && score <= alpha)){
+				return score;
+			}
+		}
+	}
+
+	const bool in_check = state.is_check();
+	const int static_eval = in_check?-kInfinity:evaluator_.evaluate(state);
+	if(!pv_node && ply > 0 && !in_check && !is_mate_score(beta)){
+		// A position far enough above beta to stay there.
+		if(parameters_.reverse_futility && depth <= parameters_.reverse_futility_max_depth &&
+				static_eval - parameters_.reverse_futility_margin * depth >= beta){
+			return static_eval;
+		}
+
+		// A position that holds beta even after passing, unless passing is
+		// the best move, which pieces make unlikely.
+		const bool whites_turn = state.get_whites_turn();
+		const int material = non_pawn_material(state,
+				whites_turn?boardlib::Color::WHITE:boardlib::Color::BLACK);
+		if(parameters_.null_move && depth >= parameters_.null_move_min_depth &&
+				static_eval >= beta && material > 0 && ply >= null_move_min_ply_ &&
+				previous_move(ply, 1).piece != Piece::NO_PIECE){
+			const int reduction = parameters_.null_move_reduction +
+					depth / parameters_.null_move_depth_divisor +
+					std::min((static_eval - beta) / parameters_.null_move_eval_divisor, 3);
+			const boardlib::NullMoveRecord record = state.make_null_move<SearchPolicy>();
+			stack_[ply] = PieceTo();
+			int score = -negamax(state, depth - 1 - reduction, ply + 1, -beta, -beta + 1);
+			state.unmake_null_move<SearchPolicy>(record);
+			if(should_abort() || is_cut_off()){
+				return 0;
+			}
+			if(score >= beta){
+				// Passing doesn't prove a mate.
+				score = is_mate_score(score)?beta:score;
+				if(material + non_pawn_material(state,
+						whites_turn?boardlib::Color::BLACK:boardlib::Color::WHITE) >
+						parameters_.null_move_verify_material){
+					return score;
+				}
+				// Verify without null moves in the plies the null move
+				// skipped, so that zugzwang shows.
+				const int previous_min_ply = null_move_min_ply_;
+				null_move_min_ply_ = ply + 3 * (depth - reduction) / 4;
+				const int verified = negamax(state, depth - reduction, ply, beta - 1, beta);
+				null_move_min_ply_ = previous_min_ply;
+				if(should_abort() || is_cut_off()){
+					return 0;
+				}
+				if(verified >= beta){
+					return score;
+				}
+			}
+		}
+	}
+
+	MoveList moves;
+	state.generate_moves(moves);
+	if(moves.empty()){
+		return in_check?-(kMateScore - ply):0;
+	}
+	if(ply == 0 && !excluded_root_moves_.empty()){
+		moves.size = std::remove_if(moves.begin(), moves.end(), [&](const Move& move){
+			return std::find(excluded_root_moves_.begin(), excluded_root_moves_.end(), move) !=
+					excluded_root_moves_.end();
+		}) - moves.begin();
+	}
+	order_moves(state, moves, ply, hit?entry.move:boardlib::kNoMove);
+
+	const int original_alpha = alpha;
+	int best = -kInfinity;
+	Move best_move = boardlib::kNoMove;
+	Move quiets[boardlib::kMaxMoves];
+	std::size_t quiet_count = 0;
+	for(std::size_t i = 0; i < moves.size; i++){
+		// Young brothers wait for the eldest, then go in parallel if some
+		// thread is idle to take them.
+		if(i > 0 && work_pool_ != nullptr && depth >= kMinSplitDepth &&
+				moves.size - i > 1 && work_pool_->get_idle() > 0){
+			best = split(state, moves, i, depth, ply, alpha, beta, best, best_move, in_check,
+					static_eval);
+			if(should_abort() || is_cut_off()){
+				return 0;
+			}
+			if(best >= beta){
+				cutoffs_++;
+				if(is_quiet(state, best_move)){
+					update_heuristics(state, ply, depth, best_move, quiets, quiet_count);
+				}
+			}
+			break;
+		}
+		const Move& move = moves[i];
+		if(is_futile(state, move, i, depth, ply, alpha, in_check, static_eval)){
+			continue;
+		}
+		const bool quiet = is_quiet(state, move);
+		const int score = search_move(state, move, i, depth, ply, alpha, beta, in_check);
+		// Only the first move is on the previous principal variation.
+		follow_pv_ = false;
+		if(should_abort() || is_cut_off()){
+			return 0;
+		}
+		if(score > best){
+			best = score;
+			if(score > alpha){
+				alpha = score;
+				best_move = move;
+				pv_table_.update(ply, move);
+				if(alpha >= beta){
+					cutoffs_++;
+					first_move_cutoffs_ += i == 0;
+					if(quiet){
+						update_heuristics(state, ply, depth, move, quiets, quiet_count);
+					}
+					break;
+				}
+			}
+		}
+		if(quiet){
+			quiets[quiet_count++] = move;
+		}
+	}
+
+	// A root search without some moves is no result for the position.
+	if(ply > 0 || excluded_root_moves_.empty()){
+		const Bound bound = best >= beta?Bound::LOWER:
+				best > original_alpha?Bound::EXACT:Bound::UPPER;
+		table_.store(key, best_move, score_to_table(best, ply), depth, bound);
+	}
+	return best;
+}
+
+int Searcher::search_move(BoardState& state, const Move& move, const std::size_t index,
+		const int depth, const int ply, const int alpha, const int beta, const bool in_check){
+	const bool quiet = is_quiet(state, move);
+	const MoveRecord record = state.make_move<SearchPolicy>(move);
+	stack_[ply] = PieceTo{record.moved_piece, move.to_square};
+	int reduction = 0;
+	if(parameters_.late_move_reductions && quiet && !in_check &&
+			depth >= parameters_.lmr_min_depth && index >= std::size_t(parameters_.lmr_min_moves) &&
+			!state.is_check()){
+		reduction = std::min<int>(reductions_[std::min(depth, kMaxPly - 1)][index], depth - 2);
+	}
+	// Only try to prove that later moves fail low, first at reduced depth.
+	int score = alpha + 1;
+	if(index > 0){
+		if(reduction > 0){
+			score = -negamax(state, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+		}
+		if(score > alpha){
+			score = -negamax(state, depth - 1, ply + 1, -alpha - 1, -alpha);
+		}
+	}
+	// The first move, and any that turn out better, get the full window.
+	if(index == 0 || (score > alpha && score < beta)){
+		researches_ += index > 0;
+		score = -negamax(state, depth - 1, ply + 1, -beta, -alpha);
+	}
+	state.unmake_move<SearchPolicy>(record);
+	return score;
+}
+
+bool Searcher::is_futile(BoardState& state, const Move& move, const std::size_t index,
+		const int depth, const int ply, const int alpha, const bool in_check,
+		const int static_eval) const{
+	if(ply == 0 || index == 0 || in_check || is_mate_score(alpha) || !is_quiet(state, move)){
+		return false;
+	}
+	const bool late = parameters_.late_move_pruning &&
+			depth <= parameters_.late_move_pruning_max_depth &&
+			index >= std::size_t(parameters_.late_move_pruning_base + depth * depth);
+	const bool futile = parameters_.futility && depth <= parameters_.futility_max_depth &&
+			static_eval + parameters_.futility_margin * depth <= alpha;
+	if(!late && !futile){
+		return false;
+	}
+	const MoveRecord record = state.make_move<SearchPolicy>(move);
+	const bool check = state.is_check();
+	state.unmake_move<SearchPolicy>(record);
+	return !check;
+}
+
+int Searcher::quiescence(BoardState& state, const int ply, int alpha, const int beta){
+	count_node(ply);
+	quiescence_nodes_++;
+	pv_table_.clear(ply);
+	// Captures can't repeat a position, so only the fifty move rule and
+	// material can draw here.
+	if(state.is_fifty_move_draw() || state.is_insufficient_material()){
+		return 0;
+	}
+	if(ply >= kMaxPly - 1){
+		return evaluator_.evaluate(state);
+	}
+
+	// Out of check, the side to move can stand pat rather than capture.
+	const bool in_check = state.is_check();
+	int best = -kInfinity;
+	int stand_pat = 0;
+	if(!in_check){
+		stand_pat = evaluator_.evaluate(state);
+		if(stand_pat >= beta){
+			return stand_pat;
+		}
+		best = stand_pat;
+		alpha = std::max(alpha, stand_pat);
+	}
+
+	MoveList moves;
+	state.generate_moves(moves);
+	if(moves.empty()){
+		return in_check?-(kMateScore - ply):0;
+	}
+	follow_pv_ = false;
+	order_moves(state, moves, ply, boardlib::kNoMove);
+
+	for(const Move& move : moves){
+		if(!in_check){
+			const Piece victim = captured_by(state, move);
+			if(victim == Piece::NO_PIECE && move.promotion == Piece::NO_PIECE){
+				continue;
+			}
+			// A capture that can't reach alpha still bounds what this node
+			// might be worth, so fail soft no lower than it could.
+			const int optimistic = stand_pat + see_value_of(victim) + kDeltaMargin;
+			if(move.promotion == Piece::NO_PIECE && optimistic <= alpha){
+				best = std::max(best, optimistic);
+				continue;
+			}
+			if(see(state, move) < 0){
+				continue;
+			}
+		}
+		const MoveRecord record = state.make_move<SearchPolicy>(move);
+		stack_[ply] = PieceTo{record.moved_piece, move.to_square};
+		const int score = -quiescence(state, ply + 1, -beta, -alpha);
+		state.unmake_move<SearchPolicy>(record);
+		if(should_abort() || is_cut_off()){
+			return 0;
+		}
+		if(score > best){
+			best = score;
+			if(score > alpha){
+				alpha = score;
+				if(alpha >= beta){
+					break;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+int Searcher::split(BoardState& state, const MoveList& moves, const std::size_t first,
+		const int depth, const int ply, int& alpha, const int beta, const int best,
+		Move& best_move, const bool in_check, const int static_eval){
+	SplitPoint split_point;
+	split_point.parent = split_point_;
+	split_point.snapshot.reset(new BoardState(state.fork()));
+	split_point.depth = depth;
+	split_point.ply = ply;
+	split_point.beta = beta;
+	split_point.alpha.store(alpha, std::memory_order_relaxed);
+	split_point.best = best;
+	split_point.best_move = best_move;
+	split_point.pv = pv_table_.line(ply);
+	split_point.previous[0] = previous_move(ply, 1);
+	split_point.previous[1] = previous_move(ply, 2);
+	split_point.in_check = in_check;
+	// Prune before handing out, with the window as it is now.
+	std::vector<SplitTask> tasks;
+	for(std::size_t i = first; i < moves.size; i++){
+		if(!is_futile(state, moves[i], i, depth, ply, alpha, in_check, static_eval)){
+			tasks.push_back(SplitTask{&split_point, moves[i], i});
+		}
+	}
+	split_point.pending.store(tasks.size(), std::memory_order_relaxed);
+	for(const SplitTask& task : tasks){
+		work_pool_->push(thread_index_, task);
+	}
+
+	// Help with the moves of this split point, or of split points below it,
+	// until they are all done.  Tasks elsewhere could outlast it.
+	while(split_point.pending.load(std::memory_order_acquire) != 0){
+		SplitTask task;
+		if(work_pool_->take(thread_index_, task, &split_point)){
+			run_task(task);
+		}else{
+			std::this_thread::yield();
+		}
+		if(should_abort() || is_cut_off()){
+			split_point.cutoff.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	alpha = split_point.alpha.load(std::memory_order_relaxed);
+	best_move = split_point.best_move;
+	pv_table_.set_line(ply, split_point.pv);
+	return split_point.best;
+}
+
+void Searcher::run_task(const SplitTask& task){
+	SplitPoint& split_point = *task.split_point;
+	const SplitPoint* const previous_split_point = split_point_;
+	split_point_ = &split_point;
+	const int alpha = split_point.alpha.load(std::memory_order_relaxed);
+	if(!is_cut_off()){
+		BoardState state = split_point.snapshot->copy();
+		state.set_prefetch_hook(TranspositionTable::prefetch_hook, &table_);
+		const int ply = split_point.ply;
+		for(int plies_ago = 1; plies_ago <= 2 && plies_ago <= ply; plies_ago++){
+			stack_[ply - plies_ago] = split_point.previous[plies_ago - 1];
+		}
+		const int score = search_move(state, task.move, task.index, split_point.depth, ply,
+				alpha, split_point.beta, split_point.in_check);
+		if(!aborted_ && !is_cut_off()){
+			std::lock_guard<std::mutex> lock(split_point.mutex);
+			if(score > split_point.best){
+				split_point.best = score;
+				if(score > split_point.alpha.load(std::memory_order_relaxed)){
+					split_point.alpha.store(score, std::memory_order_relaxed);
+					split_point.best_move = task.move;
+					split_point.pv = pv_table_.line(ply + 1);
+					split_point.pv.insert(split_point.pv.begin(), task.move);
+					if(score >= split_point.beta){
+						split_point.cutoff.store(true, std::memory_order_relaxed);
+					}
+				}
+			}
+		}
+	}
+	split_point_ = previous_split_point;
+	// The owner may return as soon as this is zero, so it is the last use.
+	split_point.pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void Searcher::start_tasks(){
+	limits_ = SearchLimits();
+	previous_pv_.clear();
+	follow_pv_ = false;
+	aborted_ = false;
+	split_point_ = nullptr;
+	null_move_min_ply_ = 0;
+	nodes_.store(0, std::memory_order_relaxed);
+	table_probes_ = 0;
+	table_hits_ = 0;
+	quiescence_nodes_ = 0;
+	std::fill(ply_nodes_, ply_nodes_ + kMaxPly, 0);
+	cutoffs_ = 0;
+	first_move_cutoffs_ = 0;
+	researches_ = 0;
+}
+
+int Searcher::search_root(BoardState& state, const int depth, const int previous_score){
+	int delta = parameters_.aspiration_window;
+	int alpha = -kInfinity;
+	int beta = kInfinity;
+	if(depth >= parameters_.aspiration_min_depth && !is_mate_score(previous_score)){
+		alpha = std::max(previous_score - delta, -kInfinity);
+		beta = std::min(previous_score + delta, kInfinity);
+	}
+	while(true){
+		follow_pv_ = true;
+		const int score = negamax(state, depth, 0, alpha, beta);
+		if(aborted_){
+			return score;
+		}
+		if(score <= alpha && alpha > -kInfinity){
+			// Bring beta down too, since the score is lower than expected.
+			aspiration_fail_lows_++;
+			beta = (alpha + beta) / 2;
+			alpha = std::max(score - delta, -kInfinity);
+		}else if(score >= beta && beta < kInfinity){
+			aspiration_fail_highs_++;
+			beta = std::min(score + delta, kInfinity);
+		}else{
+			return score;
+		}
+		delta += delta * parameters_.aspiration_growth / 100;
+	}
+}
+
+SearchInfo Searcher::search(BoardState& state, const SearchLimits& limits){
+	const auto start = std::chrono::steady_clock::now();
+	limits_ = limits;
+	previous_pv_.clear();
+	aborted_ = false;
+	null_move_min_ply_ = 0;
+	nodes_.store(0, std::memory_order_relaxed);
+	table_probes_ = 0;
+	table_hits_ = 0;
+	quiescence_nodes_ = 0;
+	std::fill(ply_nodes_, ply_nodes_ + kMaxPly, 0);
+	cutoffs_ = 0;
+	first_move_cutoffs_ = 0;
+	researches_ = 0;
+	aspiration_fail_highs_ = 0;
+	aspiration_fail_lows_ = 0;
+	// Killers are only good for nearby positions, so start afresh.
+	std::fill(&killers_[0][0], &killers_[0][0] + kMaxPly * 2, boardlib::kNoMove);
+	if(thread_index_ == 0){
+		table_.new_search();
+	}
+	state.set_prefetch_hook(TranspositionTable::prefetch_hook, &table_);
+
+	// There are only so many lines to find.
+	MoveList legal_moves;
+	state.generate_moves(legal_moves);
+	const std::size_t lines = std::max<std::size_t>(std::min<std::size_t>(multi_pv_,
+			legal_moves.size - std::min(legal_moves.size, limits.excluded_moves.size())), 1);
+	excluded_root_moves_ = limits.excluded_moves;
+
+	SearchInfo result;
+	// Only thread 0 keeps time; it stops the helpers when it is done.
+	TimeManager time_manager(thread_index_ == 0?limits:SearchLimits());
+	has_deadline_ = time_manager.is_enabled();
+	next_clock_check_ = 0;
+	deadline_ = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			time_manager.get_hard_limit());
+	const int max_depth = limits.depth > 0?std::min(limits.depth, kMaxPly - 1):kMaxPly - 1;
+	for(int depth = 1; depth <= max_depth; depth++){
+		if(skips_depth(depth)){
+			continue;
+		}
+		root_depth_ = depth;
+		std::vector<RootMove> root_moves;
+		for(std::size_t line = 0; line < lines; line++){
+			// Start from the best root move of the last iteration that is
+			// left, with its line and score.
+			const auto previous = std::find_if(result.root_moves.begin(),
+					result.root_moves.end(), [&](const RootMove& root_move){
+				return !root_move.pv.empty() && std::find(excluded_root_moves_.begin(),
+						excluded_root_moves_.end(), root_move.pv.front()) ==
+						excluded_root_moves_.end();
+			});
+			const bool searched = previous != result.root_moves.end();
+			previous_pv_ = searched?previous->pv:std::vector<Move>();
+			const int score = search_root(state, depth,
+					searched?previous->score:root_moves.empty()?result.score:
+					root_moves.back().score);
+			if(aborted_){
+				break;
+			}
+			root_moves.push_back(RootMove{score, pv_table_.line(0)});
+			if(root_moves.back().pv.empty()){
+				break;
+			}
+			excluded_root_moves_.push_back(root_moves.back().pv.front());
+		}
+		excluded_root_moves_.resize(limits.excluded_moves.size());
+		if(aborted_){
+			break;
+		}
+		// Search instability can put a later line above an earlier one.
+		std::stable_sort(root_moves.begin(), root_moves.end(),
+				[](const RootMove& a, const RootMove& b){
+			return a.score > b.score;
+		});
+		const int score = root_moves.front().score;
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start);
+		result.depth = depth;
+		result.score = score;
+		result.nodes = get_nodes();
+		result.time = elapsed;
+		result.nps = result.nodes * 1000 / std::max<std::uint64_t>(elapsed.count(), 1);
+		result.pv = root_moves.front().pv;
+		result.hashfull = table_.get_hashfull();
+		result.table_hit_rate = table_probes_ == 0?0:double(table_hits_) / table_probes_;
+		result.quiescence_nodes = quiescence_nodes_;
+		int plies = kMaxPly;
+		while(plies > 0 && ply_nodes_[plies - 1] == 0){
+			plies--;
+		}
+		result.ply_nodes.assign(ply_nodes_, ply_nodes_ + plies);
+		result.first_move_cutoff_rate = cutoffs_ == 0?0:double(first_move_cutoffs_) / cutoffs_;
+		result.researches = researches_;
+		result.aspiration_fail_highs = aspiration_fail_highs_;
+		result.aspiration_fail_lows = aspiration_fail_lows_;
+		result.root_moves = std::move(root_moves);
+		if(info_callback_){
+			info_callback_(result);
+		}
+		// Nothing changes with more depth once there is no move or the
+		// shortest mate has been found on every line.
+		if(result.pv.empty() || std::all_of(result.root_moves.begin(), result.root_moves.end(),
+				[depth](const RootMove& root_move){
+			return is_mate_score(root_move.score) &&
+					kMateScore - std::abs(root_move.score) <= depth;
+		})){
+			break;
+		}
+		time_manager.update(result.pv.front(), score, result.nodes,
+				std::chrono::steady_clock::now() - start);
+		if(time_manager.should_stop()){
+			break;
+		}
+	}
+	state.set_prefetch_hook(nullptr, nullptr);
+	return result;
+}
+
+ParallelSearcher::ParallelSearcher(const evallib::MaterialTable& material_table,
+		TranspositionTable& table, const unsigned threads, const std::size_t pawn_table_size) :
+		material_table_(material_table), table_(table), pawn_table_size_(pawn_table_size),
+		main_(new Searcher(material_table, table, pawn_table_size)),
+		mode_(ParallelMode::LAZY_SMP), multi_pv_(1), search_id_(0),
+		running_(0), quit_(false), stop_(false){
+	main_->set_stop_flag(&stop_);
+	// Report the nodes of every thread with thread 0's iterations.
+	main_->set_info_callback([this](const SearchInfo& info){
+		if(!info_callback_){
+			return;
+		}
+		SearchInfo total = info;
+		for(const std::unique_ptr<Helper>& helper : helpers_){
+			total.nodes += helper->searcher->get_nodes();
+		}
+		total.nps = total.nodes * 1000 / std::max<std::uint64_t>(total.time.count(), 1);
+		info_callback_(total);
+	});
+	start_helpers(threads);
+}
+
+ParallelSearcher::~ParallelSearcher(){
+	stop_helpers();
+}
+
+void ParallelSearcher::run_helper(Helper& helper, std::uint64_t last_search_id){
+	while(true){
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [&](){
+				return quit_ || search_id_ != last_search_id;
+			});
+			if(quit_){
+				return;
+			}
+			last_search_id = search_id_;
+		}
+		if(mode_ == ParallelMode::YBWC){
+			// Helpers run split point tasks until thread 0 is done.
+			Searcher& searcher = *helper.searcher;
+			work_pool_->add_idle(1);
+			SplitTask task;
+			while(!stop_.load(std::memory_order_relaxed)){
+				if(work_pool_->take(searcher.thread_index_, task, nullptr)){
+					work_pool_->add_idle(-1);
+					searcher.run_task(task);
+					work_pool_->add_idle(1);
+				}else{
+					std::this_thread::yield();
+				}
+			}
+			work_pool_->add_idle(-1);
+		}else{
+			// Helpers search until thread 0 is done.
+			helper.result = helper.searcher->search(*helper.root, helper.limits);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_--;
+		}
+		condition_.notify_all();
+	}
+}
+
+void ParallelSearcher::start_helpers(const unsigned count){
+	work_pool_.reset(new WorkPool(count));
+	WorkPool* const pool = mode_ == ParallelMode::YBWC?work_pool_.get():nullptr;
+	main_->set_work_pool(pool);
+	for(unsigned i = 1; i < count; i++){
+		std::unique_ptr<Helper> helper(new Helper());
+		helper->searcher.reset(new Searcher(material_table_, table_, pawn_table_size_));
+		helper->searcher->set_thread_index(i);
+		helper->searcher->set_stop_flag(&stop_);
+		helper->searcher->set_work_pool(pool);
+		helper->searcher->set_parameters(parameters_);
+		helper->thread = std::thread(&ParallelSearcher::run_helper, this,
+				std::ref(*helper), search_id_);
+		helpers_.push_back(std::move(helper));
+	}
+}
+
+void ParallelSearcher::stop_helpers(){
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	condition_.notify_all();
+	for(std::unique_ptr<Helper>& helper : helpers_){
+		helper->thread.join();
+	}
+	helpers_.clear();
+	quit_ = false;
+}
+
+void ParallelSearcher::set_threads(const unsigned threads){
+	stop_helpers();
+	start_helpers(threads);
+}
+
+void ParallelSearcher::clear_heuristics(){
+	main_->clear_heuristics();
+	for(std::unique_ptr<Helper>& helper : helpers_){
+		helper->searcher->clear_heuristics();
+	}
+}
+
+unsigned ParallelSearcher::get_threads() const{
+	return helpers_.size() + 1;
+}
+
+void ParallelSearcher::set_mode(const ParallelMode mode){
+	const unsigned threads = get_threads();
+	stop_helpers();
+	mode_ = mode;
+	start_helpers(threads);
+}
+
+ParallelMode ParallelSearcher::get_mode() const{
+	return mode_;
+}
+
+void ParallelSearcher::set_parameters(const SearchParameters& parameters){
+	parameters_ = parameters;
+	main_->set_parameters(parameters);
+	for(std::unique_ptr<Helper>& helper : helpers_){
+		helper->searcher->set_parameters(parameters);
+	}
+}
+
+const SearchParameters& ParallelSearcher::get_parameters() const{
+	return parameters_;
+}
+
+void ParallelSearcher::set_multi_pv(const unsigned multi_pv){
+	main_->set_multi_pv(multi_pv);
+	multi_pv_ = main_->get_multi_pv();
+}
+
+unsigned ParallelSearcher::get_multi_pv() const{
+	return multi_pv_;
+}
+
+void ParallelSearcher::set_info_callback(Searcher::InfoCallback callback){
+	info_callback_ = std::move(callback);
+}
+
+void ParallelSearcher::stop(){
+	stop_.store(true, std::memory_order_relaxed);
+}
+
+SearchInfo ParallelSearcher::search(BoardState& state, const SearchLimits& limits){
+	const auto start = std::chrono::steady_clock::now();
+	stop_.store(false, std::memory_order_relaxed);
+	for(std::unique_ptr<Helper>& helper : helpers_){
+		helper->result = SearchInfo();
+		// Helpers leave out the same root moves but keep no time.
+		helper->limits = SearchLimits();
+		helper->limits.excluded_moves = limits.excluded_moves;
+		if(mode_ == ParallelMode::YBWC){
+			helper->searcher->start_tasks();
+		}else{
+			// Forked clones share the record of the game so far, so helpers
+			// see repetitions of positions before the root.
+			helper->root.reset(new BoardState(state.fork()));
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		search_id_++;
+		running_ = helpers_.size();
+	}
+	condition_.notify_all();
+
+	const SearchInfo main_result = main_->search(state, limits);
+	stop_.store(true, std::memory_order_relaxed);
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		condition_.wait(lock, [&](){
+			return running_ == 0;
+		});
+	}
+
+	std::uint64_t nodes = main_->get_nodes();
+	std::uint64_t quiescence_nodes = main_->quiescence_nodes_;
+	std::uint64_t cutoffs = main_->cutoffs_;
+	std::uint64_t first_move_cutoffs = main_->first_move_cutoffs_;
+	std::uint64_t researches = main_->researches_;
+	for(const std::unique_ptr<Helper>& helper : helpers_){
+		nodes += helper->searcher->get_nodes();
+		quiescence_nodes += helper->searcher->quiescence_nodes_;
+		cutoffs += helper->searcher->cutoffs_;
+		first_move_cutoffs += helper->searcher->first_move_cutoffs_;
+		researches += helper->searcher->researches_;
+	}
+	const double first_move_cutoff_rate = cutoffs == 0?0:double(first_move_cutoffs) / cutoffs;
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start);
+
+	// Vote.  Thread 0 comes first, so it wins ties.  Only it has the
+	// lines of a MultiPV search.
+	std::vector<const SearchInfo*> results = {&main_result};
+	for(const std::unique_ptr<Helper>& helper : helpers_){
+		if(!helper->result.pv.empty() && multi_pv_ == 1){
+			results.push_back(&helper->result);
+		}
+	}
+	if(main_result.pv.empty() || results.size() == 1){
+		SearchInfo final_result = main_result;
+		final_result.nodes = nodes;
+		final_result.quiescence_nodes = quiescence_nodes;
+		final_result.first_move_cutoff_rate = first_move_cutoff_rate;
+		final_result.researches = researches;
+		final_result.time = elapsed;
+		final_result.nps = nodes * 1000 / std::max<std::uint64_t>(elapsed.count(), 1);
+		return final_result;
+	}
+	int min_score = kInfinity;
+	for(const SearchInfo* result : results){
+		min_score = std::min(min_score, result->score);
+	}
+	std::vector<std::pair<Move, std::int64_t>> votes;
+	for(const SearchInfo* result : results){
+		const std::int64_t weight = std::int64_t(result->score - min_score + 14) * result->depth;
+		auto vote = std::find_if(votes.begin(), votes.end(),
+				[&](const std::pair<Move, std::int64_t>& v){
+			return v.first == result->pv.front();
+		});
+		if(vote == votes.end()){
+			votes.emplace_back(result->pv.front(), weight);
+		}else{
+			vote->second += weight;
+		}
+	}
+	std::size_t winner = 0;
+	for(std::size_t i = 1; i < votes.size(); i++){
+		if(votes[i].second > votes[winner].second){
+			winner = i;
+		}
+	}
+	const SearchInfo* chosen = nullptr;
+	for(const SearchInfo* result : results){
+		if(result->pv.front() == votes[winner].first &&
+				(chosen == nullptr || result->depth > chosen->depth)){
+			chosen = result;
+		}
+	}
+
+	SearchInfo final_result = *chosen;
+	final_result.nodes = nodes;
+	final_result.quiescence_nodes = quiescence_nodes;
+	final_result.first_move_cutoff_rate = first_move_cutoff_rate;
+	final_result.researches = researches;
+	final_result.time = elapsed;
+	final_result.nps = nodes * 1000 / std::max<std::uint64_t>(final_result.time.count(), 1);
+	// The last report was thread 0's, so report a helper's line that won.
+	if(chosen != &main_result && info_callback_){
+		info_callback_(final_result);
+	}
+	return final_result;
+}
+
+} // namespace searchlib
@@ -33,3 +33,137 @@ TEST_CASE("Queen move generation produces correct results."){
 	REQUIRE(!queen_move_targets);
 
 }
+
+TEST_CASE("Forked BoardStates share the record and can unmake into it."){
+	std::string starting_position =
+				"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+	BoardState board = BoardState::from_fen(starting_position);
+	BoardState start_copy = board.copy();
+	MoveRecord first = board.make_move(Move(6, 21, Piece::NO_PIECE));
+	MoveRecord second = board.make_move(Move(62, 45, Piece::NO_PIECE));
+	BoardState played_copy = board.copy();
+
+	BoardState worker = board.fork();
+	REQUIRE(worker == board);
+	REQUIRE(worker == played_copy);
+
+	// Unmaking in the worker walks back through the shared record without
+	// disturbing the original.
+	worker.unmake_move(second);
+	worker.unmake_move(first);
+	REQUIRE(worker == start_copy);
+	REQUIRE(board == played_copy);
+
+	// The worker can play on from there with its own record.
+	worker.make_move(Move(6, 21, Piece::NO_PIECE));
+	worker.make_move(Move(62, 45, Piece::NO_PIECE));
+	REQUIRE(worker == board);
+}
+
+TEST_CASE("Member functions make_null_move and unmake_null_move are inverses."){
+	std::string position =
+				"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq c6 0 2";
+
+	BoardState board = BoardState::from_fen(position);
+	BoardState board_copy = board.copy();
+	NullMoveRecord record = board.make_null_move();
+	REQUIRE(!board.get_whites_turn());
+	REQUIRE(board.get_hash() == ZobristHasher::hash(board));
+	REQUIRE(board.to_fen() == "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 1 2");
+
+	board.unmake_null_move(record);
+	REQUIRE(board == board_copy);
+}
+
+TEST_CASE("Redundant data stays consistent through make and unmake."){
+	std::string starting_position =
+				"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+	BoardState board = BoardState::from_fen(starting_position);
+	BoardState start_copy = board.copy();
+
+	// 1. e4 d5 2. exd5 Qxd5 3. Nc3 then a null move.
+	std::vector<Move> moves = {Move(12, 28), Move(51, 35), Move(28, 35),
+			Move(59, 35), Move(1, 18)};
+	std::vector<MoveRecord> records;
+	for(const Move& move : moves){
+		records.push_back(board.make_move(move));
+		BoardState recomputed = board.copy();
+		recomputed.update_redundant_data();
+		REQUIRE(recomputed == board);
+	}
+	NullMoveRecord null_record = board.make_null_move();
+	BoardState recomputed = board.copy();
+	recomputed.update_redundant_data();
+	REQUIRE(recomputed == board);
+
+	board.unmake_null_move(null_record);
+	while(!records.empty()){
+		board.unmake_move(records.back());
+		records.pop_back();
+	}
+	REQUIRE(board == start_copy);
+}
+
+TEST_CASE("En passant captures are made and unmade correctly."){
+	std::string position =
+				"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3";
+
+	BoardState board = BoardState::from_fen(position);
+	BoardState board_copy = board.copy();
+	REQUIRE(board.get_en_passant_square() == 45);
+
+	// exf6 removes the pawn on f5, not anything on f6.
+	MoveRecord record = board.make_move(Move(36, 45));
+	REQUIRE(record.captured_piece == Piece::BLACK_PAWN);
+	REQUIRE(record.captured_square == 37);
+	REQUIRE(board.get_en_passant_square() == kNoEnPassant);
+	REQUIRE(board.get_hash() == ZobristHasher::hash(board));
+	REQUIRE(board.to_fen() == "rnbqkbnr/ppp1p1pp/5P2/3p4/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 3");
+	BoardState recomputed = board.copy();
+	recomputed.update_redundant_data();
+	REQUIRE(recomputed == board);
+
+	board.unmake_move(record);
+	REQUIRE(board == board_copy);
+}
+
+TEST_CASE("Make and unmake maintain only what the policy selects."){
+	std::string starting_position =
+				"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+	BoardState board = BoardState::from_fen(starting_position);
+	BoardState start_copy = board.copy();
+	std::vector<Move> moves = {Move(12, 28), Move(51, 35), Move(28, 35),
+			Move(59, 35), Move(1, 18)};
+
+	// Perft keeps the board and redundant data, but not the hash or clocks.
+	std::vector<MoveRecord> records;
+	for(const Move& move : moves){
+		records.push_back(board.make_move<PerftPolicy>(move));
+		BoardState recomputed = board.copy();
+		recomputed.update_redundant_data();
+		REQUIRE(recomputed == board);
+	}
+	REQUIRE(board.get_hash() == start_copy.get_hash());
+	REQUIRE(board.to_fen() == "rnb1kbnr/ppp1pppp/8/3q4/8/2N5/PPPP1PPP/R1BQKBNR b KQkq - 0 1");
+	while(!records.empty()){
+		board.unmake_move<PerftPolicy>(records.back());
+		records.pop_back();
+	}
+	REQUIRE(board == start_copy);
+
+	// Search keeps the hash, so it agrees with a full make.
+	BoardState full = start_copy.copy();
+	for(const Move& move : moves){
+		records.push_back(board.make_move<SearchPolicy>(move));
+		full.make_move(move);
+		REQUIRE(board.get_hash() == full.get_hash());
+	}
+	while(!records.empty()){
+		board.unmake_move<SearchPolicy>(records.back());
+		records.pop_back();
+	}
+	REQUIRE(board == start_copy);
+}
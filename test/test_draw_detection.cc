@@ -0,0 +1,76 @@
+/*
+ * test_draw_detection.cc
+ *
+ *  Test detection of repetitions, the 50 move rule and insufficient
+ *  material.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+
+using namespace boardlib;
+
+namespace {
+
+/*
+ * Play Nf3 Nf6 Ng1 Ng8, which returns to the starting position.
+ */
+void shuffle_knights(BoardState& board){
+	board.make_move(Move(6, 21));
+	board.make_move(Move(62, 45));
+	board.make_move(Move(21, 6));
+	board.make_move(Move(45, 62));
+}
+
+} // namespace
+
+TEST_CASE("Repetitions are counted from the record of keys."){
+	std::string starting_position =
+				"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+	for(bool verify : {false, true}){
+		BoardState board = BoardState::from_fen(starting_position);
+		board.set_verify_repetition(verify);
+		REQUIRE(board.is_repetition(1));
+		REQUIRE(!board.is_repetition(2));
+
+		shuffle_knights(board);
+		REQUIRE(board.is_repetition(2));
+		REQUIRE(!board.is_repetition(3));
+		REQUIRE(!board.is_draw(3));
+
+		// The repetition is still seen after the record is shared with a
+		// worker.
+		BoardState worker = board.fork();
+		shuffle_knights(worker);
+		REQUIRE(worker.is_repetition(3));
+		REQUIRE(worker.is_draw(3));
+
+		// A pawn move is irreversible, so nothing before it counts.
+		worker.make_move(Move(12, 28));
+		worker.make_move(Move(52, 36));
+		shuffle_knights(worker);
+		shuffle_knights(worker);
+		REQUIRE(worker.is_repetition(2));
+		REQUIRE(!worker.is_repetition(3));
+	}
+}
+
+TEST_CASE("The 50 move rule is read off the halfmove clock."){
+	REQUIRE(!BoardState::from_fen("4k3/8/8/8/8/8/4P3/4K3 w - - 99 80").is_fifty_move_draw());
+	REQUIRE(BoardState::from_fen("4k3/8/8/8/8/8/4P3/4K3 w - - 100 80").is_fifty_move_draw());
+	REQUIRE(BoardState::from_fen("4k3/8/8/8/8/8/4P3/4K3 w - - 100 80").is_draw(3));
+}
+
+TEST_CASE("Insufficient material is detected."){
+	REQUIRE(BoardState::from_fen("4k3/8/8/8/8/8/8/4K3 w - - 0 1").is_insufficient_material());
+	REQUIRE(BoardState::from_fen("4k3/8/8/8/8/8/8/4K1N1 w - - 0 1").is_insufficient_material());
+	REQUIRE(BoardState::from_fen("4k3/8/8/8/8/8/8/4KB2 w - - 0 1").is_insufficient_material());
+	// Bishops on same-colored squares, on both sides.
+	REQUIRE(BoardState::from_fen("4kb2/8/8/8/8/8/8/2B1K3 w - - 0 1").is_insufficient_material());
+	// Bishops on opposite-colored squares can mate.
+	REQUIRE(!BoardState::from_fen("4k3/8/8/8/8/8/8/2B1KB2 w - - 0 1").is_insufficient_material());
+	REQUIRE(!BoardState::from_fen("4k3/8/8/8/8/8/8/4KNN1 w - - 0 1").is_insufficient_material());
+	REQUIRE(!BoardState::from_fen("4k3/8/8/8/8/8/4P3/4K3 w - - 0 1").is_insufficient_material());
+	REQUIRE(!BoardState::from_fen("4k3/8/8/8/8/8/8/R3K3 w - - 0 1").is_insufficient_material());
+}
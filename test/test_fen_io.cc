@@ -21,3 +21,20 @@ TEST_CASE("Pass-through FEN reading and writing works.") {
 }
 
 
+TEST_CASE("Piece encoding helpers agree with each other and with FEN.") {
+	using namespace boardlib;
+	for (char piece_char : std::string("KQBNRPkqbnrp")) {
+		Piece piece = fen_to_piece(piece_char);
+		REQUIRE(piece_to_fen(piece) == piece_char);
+		REQUIRE(make_piece(color_of(piece), kind_of(piece)) == piece);
+		REQUIRE((color_of(piece) == Color::WHITE) == bool(isupper(piece_char)));
+	}
+	REQUIRE(color_of(Piece::NO_PIECE) == Color::NO_COLOR);
+	REQUIRE(piece_index_of(Piece::NO_PIECE) == 14);
+	REQUIRE(piece_index_of(Piece::BLACK_PAWN) == 11);
+	REQUIRE(is_slider(PieceKind::QUEEN));
+	REQUIRE(is_diagonal_slider(PieceKind::BISHOP));
+	REQUIRE(!is_diagonal_slider(PieceKind::ROOK));
+	REQUIRE(is_non_diagonal_slider(PieceKind::ROOK));
+	REQUIRE(!is_slider(PieceKind::KNIGHT));
+}
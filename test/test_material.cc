@@ -0,0 +1,90 @@
+/*
+ * test_material.cc
+ *
+ *  Test the incrementally maintained material key and the material table.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+#include <evallib.h>
+
+using namespace boardlib;
+using namespace evallib;
+
+TEST_CASE("The material key counts pieces through captures and promotions.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	const MaterialKey starting_key = board.get_material_key();
+	REQUIRE(count_of(starting_key, Piece::WHITE_PAWN) == 8);
+	REQUIRE(count_of(starting_key, Piece::BLACK_KNIGHT) == 2);
+	REQUIRE(count_of(starting_key, Piece::BLACK_QUEEN) == 1);
+	REQUIRE(count_of(starting_key, Piece::WHITE_KING) == 1);
+
+	// An en passant capture, a promotion with capture and castling.
+	std::vector<MoveRecord> records;
+	for (const char* uci : {"e2e4", "g8f6", "e4e5", "d7d5", "e5d6",
+			"e7e6", "d6c7", "f8e7", "c7b8q", "f6d5", "b8a8", "e8g8"}) {
+		records.push_back(board.make_move(uci_to_move(uci)));
+		REQUIRE(board.get_material_key() ==
+				BoardState::from_fen(board.to_fen()).get_material_key());
+	}
+	REQUIRE(count_of(board.get_material_key(), Piece::WHITE_QUEEN) == 2);
+	REQUIRE(count_of(board.get_material_key(), Piece::WHITE_PAWN) == 7);
+	REQUIRE(count_of(board.get_material_key(), Piece::BLACK_PAWN) == 6);
+	while (!records.empty()) {
+		board.unmake_move(records.back());
+		records.pop_back();
+	}
+	REQUIRE(board.get_material_key() == starting_key);
+}
+
+TEST_CASE("The material table gives phase, imbalance and scaling.") {
+	const MaterialTable table;
+	auto entry_of = [&](const std::string& fen) {
+		return table.probe(BoardState::from_fen(fen).get_material_key());
+	};
+
+	MaterialEntry entry = entry_of(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	REQUIRE(int(entry.phase) == kMaxPhase);
+	REQUIRE(entry.imbalance == Score());
+	REQUIRE(entry.endgame == Endgame::NONE);
+	REQUIRE(blend(Score(100, 200), entry) == 100);
+
+	// The bishop pair against bishop and knight without pawns.
+	entry = entry_of("4k3/8/8/3bn3/8/8/8/2B1KB2 w - - 0 1");
+	REQUIRE(int(entry.phase) == 4);
+	REQUIRE(entry.imbalance == Score(45, 80));
+
+	// Lone minor pieces can't win, and a rook against a bishop is hard to.
+	entry = entry_of("4k3/8/8/8/8/8/8/1N2K3 w - - 0 1");
+	REQUIRE(int(entry.scale[0]) == kScaleDraw);
+	REQUIRE(blend(Score(300, 300), entry) == 0);
+	entry = entry_of("4k3/8/8/8/8/8/8/1NN1K3 w - - 0 1");
+	REQUIRE(int(entry.scale[0]) == kScaleDraw);
+	entry = entry_of("4k3/8/8/3b4/8/8/8/R3K3 w - - 0 1");
+	REQUIRE(int(entry.scale[0]) > kScaleDraw);
+	REQUIRE(int(entry.scale[0]) < kScaleNormal);
+	REQUIRE(int(entry.scale[1]) == kScaleDraw);
+
+	// Extra queens from promotion are outside the table but still evaluated.
+	const MaterialKey promoted = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/QNBQKBNR w Kkq - 0 1").get_material_key();
+	REQUIRE(MaterialTable::index_of(promoted) == -1);
+	REQUIRE(int(table.probe(promoted).phase) == kMaxPhase);
+}
+
+TEST_CASE("The bare king endgame drives the king to the edge.") {
+	const MaterialTable table;
+	const BoardState centered = BoardState::from_fen("8/8/8/3k4/8/8/8/R3K3 w - - 0 1");
+	const BoardState cornered = BoardState::from_fen("k7/8/1K6/8/8/8/8/7R w - - 0 1");
+	const MaterialEntry entry = table.probe(centered.get_material_key());
+	REQUIRE(entry.endgame == Endgame::WHITE_MATES_KING);
+	REQUIRE(evaluate_endgame(cornered, entry) > evaluate_endgame(centered, entry));
+	REQUIRE(evaluate_endgame(centered, entry) > 0);
+
+	const BoardState black_wins = BoardState::from_fen("8/8/8/3K4/8/8/8/q3k3 w - - 0 1");
+	const MaterialEntry black_entry = table.probe(black_wins.get_material_key());
+	REQUIRE(black_entry.endgame == Endgame::BLACK_MATES_KING);
+	REQUIRE(evaluate_endgame(black_wins, black_entry) < 0);
+}
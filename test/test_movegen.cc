@@ -0,0 +1,89 @@
+/*
+ * test_movegen.cc
+ *
+ *  Test legal move generation by counting the leaf nodes of move trees
+ *  (perft) against the well known values.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+
+using namespace boardlib;
+
+namespace {
+
+std::uint64_t perft(BoardState& board, const int depth) {
+	MoveList moves;
+	board.generate_moves(moves);
+	if (depth == 1) {
+		return moves.size;
+	}
+	std::uint64_t result = 0;
+	for (const Move& move : moves) {
+		const MoveRecord record = board.make_move<PerftPolicy>(move);
+		result += perft(board, depth - 1);
+		board.unmake_move<PerftPolicy>(record);
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Perft counts from the starting position.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	REQUIRE(perft(board, 1) == 20);
+	REQUIRE(perft(board, 2) == 400);
+	REQUIRE(perft(board, 3) == 8902);
+	REQUIRE(perft(board, 4) == 197281);
+	REQUIRE(board.to_fen() == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+}
+
+TEST_CASE("Perft counts with castling, en passant and promotion.") {
+	// "Kiwipete", which has every kind of special move.
+	BoardState kiwipete = BoardState::from_fen(
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+	REQUIRE(perft(kiwipete, 1) == 48);
+	REQUIRE(perft(kiwipete, 2) == 2039);
+	REQUIRE(perft(kiwipete, 3) == 97862);
+
+	// En passant captures that would expose the king along a rank.
+	BoardState endgame = BoardState::from_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+	REQUIRE(perft(endgame, 1) == 14);
+	REQUIRE(perft(endgame, 2) == 191);
+	REQUIRE(perft(endgame, 3) == 2812);
+	REQUIRE(perft(endgame, 4) == 43238);
+
+	BoardState promotions = BoardState::from_fen(
+			"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+	REQUIRE(perft(promotions, 1) == 6);
+	REQUIRE(perft(promotions, 2) == 264);
+	REQUIRE(perft(promotions, 3) == 9467);
+
+	BoardState tricky = BoardState::from_fen(
+			"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+	REQUIRE(perft(tricky, 1) == 44);
+	REQUIRE(perft(tricky, 2) == 1486);
+	REQUIRE(perft(tricky, 3) == 62379);
+}
+
+TEST_CASE("Check and checkmate are recognized.") {
+	// Fool's mate.
+	BoardState board = BoardState::from_fen(
+			"rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+	MoveList moves;
+	board.generate_moves(moves);
+	REQUIRE(board.is_check());
+	REQUIRE(moves.empty());
+
+	// Stalemate.
+	const BoardState stalemate = BoardState::from_fen("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+	stalemate.generate_moves(moves);
+	REQUIRE_FALSE(stalemate.is_check());
+	REQUIRE(moves.empty());
+
+	const BoardState castling = BoardState::from_fen("4k3/8/8/8/8/8/8/4K2R w K - 0 1");
+	castling.generate_moves(moves);
+	REQUIRE(moves.contains(uci_to_move("e1g1")));
+	REQUIRE(moves.size == 15);
+}
@@ -0,0 +1,95 @@
+/*
+ * test_pawn_hash.cc
+ *
+ *  Test the incrementally maintained pawn key and the pawn hash table.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+#include <evallib.h>
+
+using namespace boardlib;
+using namespace evallib;
+
+TEST_CASE("The pawn key is maintained through captures and promotions.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	REQUIRE(board.get_pawn_key() == ZobristHasher::hash_pawns(board));
+	const ZobristKey starting_key = board.get_pawn_key();
+
+	// A knight move leaves the pawn key alone.
+	board.make_move(uci_to_move("g1f3"));
+	REQUIRE(board.get_pawn_key() == starting_key);
+	board.make_move(uci_to_move("g8f6"));
+	board.make_move(uci_to_move("f3g1"));
+	board.make_move(uci_to_move("f6g8"));
+	REQUIRE(board.get_pawn_key() == starting_key);
+
+	// An en passant capture, a promotion with capture and a piece capturing
+	// a pawn.
+	std::vector<MoveRecord> records;
+	for (const char* uci : {"e2e4", "g8f6", "e4e5", "d7d5", "e5d6",
+			"e7e6", "d6c7", "f8e7", "c7b8q", "f6d5", "b8a8", "d5c3", "b2c3"}) {
+		records.push_back(board.make_move(uci_to_move(uci)));
+		REQUIRE(board.get_pawn_key() == ZobristHasher::hash_pawns(board));
+	}
+	while (!records.empty()) {
+		board.unmake_move(records.back());
+		records.pop_back();
+		REQUIRE(board.get_pawn_key() == ZobristHasher::hash_pawns(board));
+	}
+	REQUIRE(board.get_pawn_key() == starting_key);
+}
+
+TEST_CASE("Pawn structures are evaluated.") {
+	// White has passed pawns on a2, f2 and h2, of which f2 and h2 are
+	// isolated, and c2 is backward because d4 attacks c3.
+	BoardState board = BoardState::from_fen(
+			"4k3/8/2p5/8/3p4/1P6/P1P2P1P/4K3 w - - 0 1");
+	PawnEntry entry;
+	evaluate_pawns(board.get_pieces(Piece::WHITE_PAWN),
+			board.get_pieces(Piece::BLACK_PAWN), entry);
+	REQUIRE(entry.passed == (kSquare8 | kSquare13 | kSquare15));
+	REQUIRE(entry.isolated == (kSquare13 | kSquare15));
+	REQUIRE(entry.doubled == kEmpty);
+	REQUIRE(entry.backward == kSquare10);
+	REQUIRE(entry.score == Score(-4, -24));
+
+	// Mirroring the structure negates the score.
+	BoardState mirrored = BoardState::from_fen(
+			"4k3/p1p2p1p/1p6/3P4/8/2P5/8/4K3 w - - 0 1");
+	evaluate_pawns(mirrored.get_pieces(Piece::WHITE_PAWN),
+			mirrored.get_pieces(Piece::BLACK_PAWN), entry);
+	REQUIRE(entry.score == Score(4, 24));
+
+	// Doubled pawns, of which only the front one can be passed.
+	evaluate_pawns(kSquare10 | kSquare18, kEmpty, entry);
+	REQUIRE(entry.doubled == kSquare10);
+	REQUIRE(entry.passed == kSquare18);
+}
+
+TEST_CASE("The pawn hash table caches evaluations.") {
+	PawnHashTable table(1 << 16);
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	REQUIRE(table.probe(board).score == Score());
+	REQUIRE(table.get_hits() == 0);
+
+	// Piece moves keep the pawn structure, so every later probe hits.
+	for (const char* uci : {"g1f3", "g8f6", "f3g1", "f6g8"}) {
+		board.make_move(uci_to_move(uci));
+		table.probe(board);
+	}
+	REQUIRE(table.get_probes() == 5);
+	REQUIRE(table.get_hits() == 4);
+
+	board.make_move(uci_to_move("e2e4"));
+	const PawnEntry& entry = table.probe(board);
+	REQUIRE(entry.key == board.get_pawn_key());
+	REQUIRE(table.get_hits() == 4);
+	REQUIRE(table.get_hit_rate() == Approx(4.0 / 6.0));
+
+	table.clear();
+	REQUIRE(table.get_probes() == 0);
+	REQUIRE(table.get_hits() == 0);
+}
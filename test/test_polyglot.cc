@@ -0,0 +1,91 @@
+/*
+ * test_polyglot.cc
+ *
+ *  Test Polyglot key computation.  The scheme is tested with stand-in
+ *  random numbers, and the published Random64 array against the published
+ *  keys.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+
+using namespace boardlib;
+
+namespace {
+
+const std::string kStartingPosition =
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+const PolyglotHasher kStandInHasher(
+		generate_zobrist_numbers<PolyglotHasher::kRandomTableSize>(0x0123456789ABCDEFULL));
+
+} // namespace
+
+TEST_CASE("Polyglot update gives the same results as full computation.") {
+	BoardState board = BoardState::from_fen(kStartingPosition);
+	ZobristKey key = kStandInHasher.hash(board);
+	std::vector<ZobristKey> keys = {key};
+	std::vector<MoveRecord> records;
+	// Double steps with and without a pawn to take en passant, an en
+	// passant capture, a promotion with capture and castling.
+	for (const char* uci : {"e2e4", "g8f6", "e4e5", "d7d5", "e5d6",
+			"e7e6", "d6c7", "f8e7", "c7b8q", "f6d5", "b8a8", "e8g8", "a2a4"}) {
+		records.push_back(board.make_move(uci_to_move(uci)));
+		key = kStandInHasher.update(key, board, records.back());
+		REQUIRE(key == kStandInHasher.hash(board));
+		keys.push_back(key);
+	}
+	const NullMoveRecord null_record = board.make_null_move();
+	key = kStandInHasher.update(key, board, null_record);
+	REQUIRE(key == kStandInHasher.hash(board));
+	key = kStandInHasher.update(key, board, null_record);
+	board.unmake_null_move(null_record);
+	REQUIRE(key == keys.back());
+
+	// Unmaking takes the board with the move still made.
+	while (!records.empty()) {
+		keys.pop_back();
+		key = kStandInHasher.update(key, board, records.back());
+		board.unmake_move(records.back());
+		records.pop_back();
+		REQUIRE(key == keys.back());
+	}
+}
+
+TEST_CASE("Polyglot keys en passant squares only when a capture is possible.") {
+	// No black pawn next to e4.
+	REQUIRE(kStandInHasher.hash(BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1")) ==
+			kStandInHasher.hash(BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")));
+	// A black pawn on d4 could take.
+	REQUIRE(kStandInHasher.hash(BoardState::from_fen(
+			"rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1")) !=
+			kStandInHasher.hash(BoardState::from_fen(
+			"rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")));
+}
+
+TEST_CASE("Polyglot keys match the published reference keys.") {
+	const PolyglotHasher hasher;
+	const std::vector<std::pair<std::string, ZobristKey>> lines = {
+			{"", 0x463b96181691fc9cULL},
+			{"e2e4", 0x823c9b50fd114196ULL},
+			{"e2e4 d7d5", 0x0756b94461c50fb0ULL},
+			{"e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL},
+			{"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL},
+			{"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL},
+			{"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL},
+			{"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL},
+			{"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL}};
+	for (const auto& line : lines) {
+		BoardState board = BoardState::from_fen(kStartingPosition);
+		ZobristKey key = hasher.hash(board);
+		if (!line.first.empty()) {
+			for (const std::string& uci : split_string(line.first, " ")) {
+				key = hasher.update(key, board, board.make_move(uci_to_move(uci)));
+			}
+		}
+		REQUIRE(hasher.hash(board) == line.second);
+		REQUIRE(key == line.second);
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * test_replay.cc
+ *
+ *  Test UCI move notation and the replay of known-legal move sequences.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+
+using namespace boardlib;
+
+TEST_CASE("UCI move notation is read and written.") {
+	REQUIRE(uci_to_move("e2e4") == Move(12, 28));
+	REQUIRE(uci_to_move("c7b8q") == Move(50, 57, Piece::WHITE_QUEEN));
+	REQUIRE(uci_to_move("a2a1n") == Move(8, 0, Piece::BLACK_KNIGHT));
+	for (std::string uci : {"e2e4", "e1g1", "c7b8q", "a2a1n"}) {
+		REQUIRE(move_to_uci(uci_to_move(uci)) == uci);
+	}
+}
+
+TEST_CASE("Replay agrees with make_move, including special moves.") {
+	std::string starting_position =
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	// An en passant capture, a promotion with capture, a rook captured at
+	// home and kingside castling.
+	std::vector<std::string> line = {"e2e4", "g8f6", "e4e5", "d7d5", "e5d6",
+			"e7e6", "d6c7", "f8e7", "c7b8q", "f6d5", "b8a8", "e8g8"};
+	std::vector<Move> moves;
+	for (const std::string& uci : line) {
+		moves.push_back(uci_to_move(uci));
+	}
+
+	BoardState played = BoardState::from_fen(starting_position);
+	std::vector<ZobristKey> played_keys;
+	for (const Move& move : moves) {
+		played.make_move(move);
+		played_keys.push_back(played.get_hash());
+		REQUIRE(played.get_hash() == ZobristHasher::hash(played));
+	}
+	REQUIRE(played.to_fen() == "Q1bq1rk1/pp2bppp/4p3/3n4/8/8/PPPP1PPP/RNBQKBNR w KQ - 1 7");
+
+	BoardState replayed = BoardState::from_fen(starting_position);
+	std::vector<ZobristKey> replayed_keys(moves.size());
+	replayed.replay<ReplayPolicy>(moves.data(), moves.size(), replayed_keys.data());
+	REQUIRE(replayed_keys == played_keys);
+	REQUIRE(replayed.to_fen() == played.to_fen());
+
+	BoardState full = BoardState::from_fen(starting_position);
+	full.replay(moves.data(), moves.size());
+	REQUIRE(full == played);
+}
+
+TEST_CASE("Replaying the Opera Game reaches its final position.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	std::vector<Move> moves;
+	for (const std::string& uci : split_string("e2e4 e7e5 g1f3 d7d6 d2d4 c8g4 "
+			"d4e5 g4f3 d1f3 d6e5 f1c4 g8f6 f3b3 d8e7 b1c3 c7c6 c1g5 b7b5 c3b5 "
+			"c6b5 c4b5 b8d7 e1c1 a8d8 d1d7 d8d7 h1d1 e7e6 b5d7 f6d7 b3b8 d7b8 "
+			"d1d8", " ")) {
+		moves.push_back(uci_to_move(uci));
+	}
+	board.replay(moves.data(), moves.size());
+	REQUIRE(board.to_fen() == "1n1Rkb1r/p4ppp/4q3/4p1B1/4P3/8/PPP2PPP/2K5 b k - 1 17");
+	REQUIRE(board.get_hash() == ZobristHasher::hash(board));
+}
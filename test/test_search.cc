@@ -0,0 +1,430 @@
+/*
+ * test_search.cc
+ *
+ *  Test the iterative deepening alpha-beta search.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+#include <evallib.h>
+#include <searchlib.h>
+
+using namespace boardlib;
+using namespace searchlib;
+
+namespace {
+
+const evallib::MaterialTable& material_table(){
+	static const evallib::MaterialTable table;
+	return table;
+}
+
+SearchInfo search_fen(const std::string& fen, const int depth){
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen(fen);
+	SearchLimits limits;
+	limits.depth = depth;
+	return searcher.search(board, limits);
+}
+
+} // namespace
+
+TEST_CASE("Search finds mates and reports them by distance.") {
+	// Back rank mate in one, which quiescence search proves by finding no
+	// evasions.
+	SearchInfo info = search_fen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 4);
+	REQUIRE(move_to_uci(info.pv.front()) == "a1a8");
+	REQUIRE(info.score == kMateScore - 1);
+	REQUIRE(info.depth == 1);
+
+	// A rook roller mate in two.
+	info = search_fen("7k/8/8/8/8/8/8/RR4K1 w - - 0 1", 4);
+	REQUIRE((move_to_uci(info.pv.front()) == "a1a7" || move_to_uci(info.pv.front()) == "b1b7"));
+	REQUIRE(info.score == kMateScore - 3);
+	REQUIRE(info.pv.size() == 3);
+
+	// The side to move is mated or stalemated.
+	info = search_fen("rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", 3);
+	REQUIRE(info.pv.empty());
+	REQUIRE(info.score == -kMateScore);
+	info = search_fen("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", 3);
+	REQUIRE(info.pv.empty());
+	REQUIRE(info.score == 0);
+}
+
+TEST_CASE("Search wins material and leaves the board as it was.") {
+	// The knight forks king and queen.
+	const std::string fen = "2q3k1/8/8/3N4/8/8/5PPP/6K1 w - - 0 1";
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen(fen);
+	std::vector<SearchInfo> iterations;
+	searcher.set_info_callback([&](const SearchInfo& info){
+		iterations.push_back(info);
+	});
+	SearchLimits limits;
+	limits.depth = 4;
+	const SearchInfo info = searcher.search(board, limits);
+	REQUIRE(move_to_uci(info.pv.front()) == "d5e7");
+	REQUIRE(info.score > 300);
+	REQUIRE(board.to_fen() == BoardState::from_fen(fen).to_fen());
+
+	// One report per iteration, with the node counts growing.
+	REQUIRE(iterations.size() == 4);
+	for(std::size_t i = 1; i < iterations.size(); i++){
+		REQUIRE(iterations[i].depth == iterations[i - 1].depth + 1);
+		REQUIRE(iterations[i].nodes > iterations[i - 1].nodes);
+	}
+
+	// Every move of the principal variation is legal where it is played.
+	for(const Move& move : info.pv){
+		MoveList moves;
+		board.generate_moves(moves);
+		REQUIRE(moves.contains(move));
+		board.make_move(move);
+	}
+}
+
+TEST_CASE("Static exchange evaluation counts recaptures.") {
+	auto see_fen = [](const std::string& fen, const std::string& move){
+		return see(BoardState::from_fen(fen), uci_to_move(move));
+	};
+	// A pawn defended by a pawn, and an undefended one.
+	REQUIRE(see_fen("4k3/8/2p5/3p4/8/8/3Q4/4K3 w - - 0 1", "d2d5") == 90 - 900);
+	REQUIRE(see_fen("4k3/8/8/3p4/8/8/8/3QK3 w - - 0 1", "d1d5") == 90);
+
+	// The queen x-rays through the rook, so RxN, pxR, QxP wins a knight
+	// and a pawn for the rook, but with a second defender white stops
+	// after pxR.
+	REQUIRE(see_fen("4k3/8/4p3/3n4/8/8/3R4/3QK3 w - - 0 1", "d2d5") == 320 - 500 + 90);
+	REQUIRE(see_fen("4k3/8/2p1p3/3n4/8/8/3R4/3QK3 w - - 0 1", "d2d5") == 320 - 500);
+
+	// En passant, and promotions that are taken back, by the king only
+	// once the square is undefended.
+	REQUIRE(see_fen("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6") == 90);
+	REQUIRE(see_fen("3rk3/2P5/8/8/8/8/8/4K3 w - - 0 1", "c7c8q") == -90);
+	REQUIRE(see_fen("3rk3/2P5/8/8/8/8/8/4K3 w - - 0 1", "c7d8q") == 500 - 90);
+	REQUIRE(see_fen("3rk3/2P5/8/8/8/8/8/3RK3 w - - 0 1", "c7d8q") == 500 + 900 - 90);
+}
+
+TEST_CASE("Quiescence search sees through exchanges at the horizon.") {
+	// At depth 1 the queen would take the pawn if the recapture were not
+	// searched.
+	const SearchInfo info = search_fen("4k3/8/2p5/3p4/8/8/3Q4/4K3 w - - 0 1", 1);
+	REQUIRE(move_to_uci(info.pv.front()) != "d2d5");
+	REQUIRE(info.score > 0);
+
+	// Every node is counted at its ply, and quiescence nodes are among them.
+	REQUIRE(info.quiescence_nodes > 0);
+	REQUIRE(info.ply_nodes.size() > 2);
+	REQUIRE(info.ply_nodes.front() == 1);
+	std::uint64_t total = 0;
+	for(const std::uint64_t nodes : info.ply_nodes){
+		total += nodes;
+	}
+	REQUIRE(total == info.nodes);
+}
+
+TEST_CASE("Search stops at the node limit after the first iteration.") {
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	SearchLimits limits;
+	limits.nodes = 1;
+	SearchInfo info = searcher.search(board, limits);
+	REQUIRE(info.depth == 1);
+	REQUIRE(info.pv.size() == 1);
+
+	limits.nodes = 20000;
+	info = searcher.search(board, limits);
+	REQUIRE(info.depth >= 2);
+	REQUIRE(info.nodes <= 20000);
+}
+
+TEST_CASE("The time manager budgets the clock and adapts to the search.") {
+	typedef TimeManager::Duration Duration;
+	SearchLimits limits;
+	REQUIRE(!TimeManager(limits).is_enabled());
+
+	// A thirtieth of the time after the overhead, and most of the increment.
+	limits.time = std::chrono::milliseconds(60030);
+	TimeManager sudden_death(limits);
+	REQUIRE(sudden_death.is_enabled());
+	REQUIRE(sudden_death.get_soft_limit().count() == Approx(2000));
+	REQUIRE(sudden_death.get_hard_limit().count() == Approx(10000));
+	limits.increment = std::chrono::milliseconds(1000);
+	REQUIRE(TimeManager(limits).get_soft_limit().count() == Approx(2750));
+	limits.increment = std::chrono::milliseconds(0);
+	limits.moves_to_go = 1;
+	REQUIRE(TimeManager(limits).get_hard_limit().count() == Approx(54000));
+	REQUIRE(TimeManager(limits).get_soft_limit() == TimeManager(limits).get_hard_limit());
+	limits.moves_to_go = 0;
+
+	// Iterations four times as big as the last, at a thousand nodes per
+	// millisecond, predict the next one.
+	const Move e2e4 = uci_to_move("e2e4"), d2d4 = uci_to_move("d2d4");
+	TimeManager stable(limits);
+	stable.update(e2e4, 20, 1000, Duration(1));
+	REQUIRE(stable.predict_next_iteration().count() == 0);
+	stable.update(e2e4, 20, 5000, Duration(5));
+	REQUIRE(stable.predict_next_iteration().count() == Approx(16));
+	stable.update(e2e4, 20, 21000, Duration(21));
+	stable.update(e2e4, 20, 85000, Duration(85));
+	stable.update(e2e4, 20, 341000, Duration(341));
+	REQUIRE(stable.predict_next_iteration().count() == Approx(1024));
+	REQUIRE(!stable.should_stop());
+	REQUIRE(stable.get_soft_limit().count() < 2000);
+
+	// The same search with a new best move every iteration gets more
+	// time, and more again if the score drops.
+	TimeManager unstable(limits);
+	unstable.update(e2e4, 20, 1000, Duration(1));
+	unstable.update(d2d4, 20, 5000, Duration(5));
+	unstable.update(e2e4, 20, 21000, Duration(21));
+	REQUIRE(unstable.get_soft_limit().count() > 2000);
+	TimeManager dropping = unstable;
+	unstable.update(d2d4, 20, 85000, Duration(85));
+	dropping.update(d2d4, -80, 85000, Duration(85));
+	REQUIRE(dropping.get_soft_limit() > unstable.get_soft_limit());
+
+	// Stop once the next iteration cannot finish before the hard limit.
+	unstable.update(e2e4, -80, 2000000, Duration(2000));
+	REQUIRE(unstable.should_stop());
+}
+
+TEST_CASE("Search stops for time.") {
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen(
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+	SearchLimits limits;
+	limits.move_time = std::chrono::milliseconds(100);
+	SearchInfo info = searcher.search(board, limits);
+	REQUIRE(info.depth >= 2);
+	REQUIRE(!info.pv.empty());
+	REQUIRE(info.time.count() < 1000);
+
+	limits.move_time = std::chrono::milliseconds(0);
+	limits.time = std::chrono::milliseconds(1000);
+	info = searcher.search(board, limits);
+	REQUIRE(!info.pv.empty());
+	REQUIRE(info.time.count() < 1000);
+}
+
+TEST_CASE("Search reuses results from the transposition table.") {
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen(
+			"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+	SearchLimits limits;
+	limits.depth = 4;
+	const SearchInfo first = searcher.search(board, limits);
+	const SearchInfo second = searcher.search(board, limits);
+	REQUIRE(second.nodes < first.nodes);
+	REQUIRE(second.table_hit_rate > first.table_hit_rate);
+	REQUIRE(second.pv.front() == first.pv.front());
+}
+
+TEST_CASE("Move ordering makes most cutoffs on the first move.") {
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen(
+			"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8");
+	SearchLimits limits;
+	limits.depth = 5;
+	const SearchInfo first = searcher.search(board, limits);
+	REQUIRE(first.first_move_cutoff_rate > 0.65);
+	REQUIRE(first.first_move_cutoff_rate <= 1);
+
+	// What was learned carries over to the next search until cleared.
+	table.clear();
+	const SearchInfo second = searcher.search(board, limits);
+	REQUIRE(second.nodes < first.nodes);
+	searcher.clear_heuristics();
+	table.clear();
+	REQUIRE(searcher.search(board, limits).nodes == first.nodes);
+}
+
+TEST_CASE("Selective search is smaller and still finds tactics.") {
+	SearchParameters full_width;
+	for(const ParameterInfo& info : get_parameter_info()){
+		// Defaults are in range, and switches turn off at 0.
+		REQUIRE(full_width.*info.value >= info.min);
+		REQUIRE(full_width.*info.value <= info.max);
+		if(info.max == 1){
+			full_width.*info.value = 0;
+		}
+	}
+	const std::string fen = "2q3k1/8/8/3N4/8/8/5PPP/6K1 w - - 0 1";
+	BoardState board = BoardState::from_fen(fen);
+	SearchLimits limits;
+	limits.depth = 6;
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	const SearchInfo selective = searcher.search(board, limits);
+	REQUIRE(move_to_uci(selective.pv.front()) == "d5e7");
+
+	table.clear();
+	searcher.clear_heuristics();
+	searcher.set_parameters(full_width);
+	REQUIRE(searcher.get_parameters().null_move == 0);
+	const SearchInfo full = searcher.search(board, limits);
+	REQUIRE(move_to_uci(full.pv.front()) == "d5e7");
+	REQUIRE(selective.nodes < full.nodes);
+	REQUIRE(board.to_fen() == BoardState::from_fen(fen).to_fen());
+}
+
+TEST_CASE("Null move cutoffs are verified in endings with pieces.") {
+	// A rook and a knight each, where the search misses that Nxd5 wins a
+	// pawn unless its null move cutoffs are verified.
+	BoardState board = BoardState::from_fen("8/8/1p1r1k2/p1pPN1p1/P3KnP1/1P6/8/3R4 b - - 0 1");
+	SearchLimits limits;
+	limits.depth = 10;
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	const SearchInfo info = searcher.search(board, limits);
+	REQUIRE(move_to_uci(info.pv.front()) == "f4d5");
+	REQUIRE(info.score > -20);
+}
+
+TEST_CASE("Aspiration windows widen until the score falls inside.") {
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	BoardState board = BoardState::from_fen("2q3k1/8/8/3N4/8/8/5PPP/6K1 w - - 0 1");
+	SearchParameters parameters;
+	parameters.aspiration_min_depth = 2;
+	parameters.aspiration_window = 1;
+	searcher.set_parameters(parameters);
+	SearchLimits limits;
+	limits.depth = 6;
+	const SearchInfo narrow = searcher.search(board, limits);
+	REQUIRE(move_to_uci(narrow.pv.front()) == "d5e7");
+	REQUIRE(narrow.aspiration_fail_highs + narrow.aspiration_fail_lows > 0);
+	REQUIRE(narrow.researches > 0);
+
+	// Without aspiration windows nothing fails at the root.
+	parameters.aspiration_min_depth = kMaxPly;
+	searcher.set_parameters(parameters);
+	table.clear();
+	const SearchInfo full = searcher.search(board, limits);
+	REQUIRE(move_to_uci(full.pv.front()) == "d5e7");
+	REQUIRE(full.aspiration_fail_highs + full.aspiration_fail_lows == 0);
+}
+
+TEST_CASE("MultiPV search finds the best root moves in one search.") {
+	const std::string kiwipete =
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+	TranspositionTable table(1 << 20);
+	Searcher searcher(material_table(), table, 1 << 16);
+	SearchParameters full_width;
+	full_width.null_move = 0;
+	full_width.late_move_reductions = 0;
+	full_width.reverse_futility = 0;
+	full_width.futility = 0;
+	full_width.late_move_pruning = 0;
+	searcher.set_parameters(full_width);
+	searcher.set_multi_pv(4);
+	BoardState board = BoardState::from_fen(kiwipete);
+	SearchLimits limits;
+	limits.depth = 4;
+	const SearchInfo info = searcher.search(board, limits);
+	REQUIRE(info.root_moves.size() == 4);
+	REQUIRE(info.score == info.root_moves.front().score);
+	REQUIRE(info.pv == info.root_moves.front().pv);
+
+	// Each line has a different move, a principal variation as long as the
+	// search is deep and the score searching its move alone would give.
+	for(std::size_t i = 0; i < info.root_moves.size(); i++){
+		const RootMove& root_move = info.root_moves[i];
+		REQUIRE(root_move.pv.size() >= std::size_t(limits.depth));
+		if(i > 0){
+			REQUIRE(root_move.score <= info.root_moves[i - 1].score);
+			REQUIRE(!(root_move.pv.front() == info.root_moves[i - 1].pv.front()));
+		}
+		TranspositionTable child_table(1 << 20);
+		Searcher child_searcher(material_table(), child_table, 1 << 16);
+		child_searcher.set_parameters(full_width);
+		BoardState child = BoardState::from_fen(kiwipete);
+		child.make_move(root_move.pv.front());
+		SearchLimits child_limits;
+		child_limits.depth = limits.depth - 1;
+		REQUIRE(-child_searcher.search(child, child_limits).score == root_move.score);
+	}
+
+	// Leaving out the first line's move finds the second line.
+	TranspositionTable excluding_table(1 << 20);
+	Searcher excluding_searcher(material_table(), excluding_table, 1 << 16);
+	excluding_searcher.set_parameters(full_width);
+	SearchLimits excluding_limits = limits;
+	excluding_limits.excluded_moves.push_back(info.pv.front());
+	const SearchInfo second = excluding_searcher.search(board, excluding_limits);
+	REQUIRE(second.score == info.root_moves[1].score);
+	REQUIRE(!(second.pv.front() == info.pv.front()));
+
+	// There are no more lines than legal moves.
+	BoardState cornered = BoardState::from_fen("7k/8/8/8/8/8/8/R6K b - - 0 1");
+	MoveList moves;
+	cornered.generate_moves(moves);
+	searcher.set_multi_pv(moves.size + 2);
+	REQUIRE(searcher.search(cornered, limits).root_moves.size() == moves.size);
+}
+
+TEST_CASE("Lazy SMP search agrees with a single thread on clear positions.") {
+	TranspositionTable table(1 << 20);
+	ParallelSearcher searcher(material_table(), table, 3, 1 << 16);
+	REQUIRE(searcher.get_threads() == 3);
+	const std::string fen = "2q3k1/8/8/3N4/8/8/5PPP/6K1 w - - 0 1";
+	BoardState board = BoardState::from_fen(fen);
+	std::vector<SearchInfo> iterations;
+	searcher.set_info_callback([&](const SearchInfo& info){
+		iterations.push_back(info);
+	});
+	SearchLimits limits;
+	limits.depth = 4;
+	SearchInfo info = searcher.search(board, limits);
+	REQUIRE(move_to_uci(info.pv.front()) == "d5e7");
+	REQUIRE(info.depth >= 4);
+	REQUIRE(iterations.size() >= 4);
+	REQUIRE(info.nodes >= iterations.back().nodes);
+
+	// The last report is of the line the vote picked.
+	REQUIRE(iterations.back().pv == info.pv);
+	REQUIRE(board.to_fen() == BoardState::from_fen(fen).to_fen());
+
+	// The threads persist across searches and can be resized between them.
+	searcher.set_threads(2);
+	info = searcher.search(board, limits);
+	REQUIRE(move_to_uci(info.pv.front()) == "d5e7");
+	BoardState mate = BoardState::from_fen("7k/8/8/8/8/8/8/RR4K1 w - - 0 1");
+	info = searcher.search(mate, limits);
+	REQUIRE(info.score == kMateScore - 3);
+}
+
+TEST_CASE("YBWC search agrees with a single thread on clear positions.") {
+	TranspositionTable table(1 << 20);
+	ParallelSearcher searcher(material_table(), table, 3, 1 << 16);
+	searcher.set_mode(ParallelMode::YBWC);
+	REQUIRE(searcher.get_mode() == ParallelMode::YBWC);
+	REQUIRE(searcher.get_threads() == 3);
+	const std::string fen = "2q3k1/8/8/3N4/8/8/5PPP/6K1 w - - 0 1";
+	BoardState board = BoardState::from_fen(fen);
+	SearchLimits limits;
+	limits.depth = 5;
+	SearchInfo info = searcher.search(board, limits);
+	REQUIRE(move_to_uci(info.pv.front()) == "d5e7");
+	REQUIRE(info.depth == 5);
+	REQUIRE(info.score > 300);
+	REQUIRE(board.to_fen() == BoardState::from_fen(fen).to_fen());
+	for(const Move& move : info.pv){
+		MoveList moves;
+		board.generate_moves(moves);
+		REQUIRE(moves.contains(move));
+		board.make_move(move);
+	}
+
+	BoardState mate = BoardState::from_fen("7k/8/8/8/8/8/8/RR4K1 w - - 0 1");
+	info = searcher.search(mate, limits);
+	REQUIRE(info.score == kMateScore - 3);
+}
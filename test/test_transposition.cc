@@ -0,0 +1,135 @@
+/*
+ * test_transposition.cc
+ *
+ *  Test the lock free transposition table.
+ *
+ */
+#include "catch.hpp"
+#include <boardlib.h>
+#include <searchlib.h>
+
+#include <limits>
+#include <thread>
+
+using namespace boardlib;
+using namespace searchlib;
+
+TEST_CASE("Moves pack into 16 bits.") {
+	for(const char* uci : {"e2e4", "a1h8", "h8a1", "e7e8q", "b2a1n", "g7g8r", "c2c1b"}) {
+		const Move move = uci_to_move(uci);
+		REQUIRE(unpack_move(pack_move(move)) == move);
+	}
+	REQUIRE(pack_move(kNoMove) == 0);
+}
+
+TEST_CASE("Mate scores are stored relative to the node.") {
+	const int mate_at_ply_7 = kMateScore - 7;
+	REQUIRE(score_to_table(mate_at_ply_7, 4) == kMateScore - 3);
+	REQUIRE(score_from_table(score_to_table(mate_at_ply_7, 4), 2) == kMateScore - 5);
+	REQUIRE(score_from_table(score_to_table(-mate_at_ply_7, 4), 4) == -mate_at_ply_7);
+	REQUIRE(score_to_table(150, 9) == 150);
+}
+
+TEST_CASE("The transposition table stores and replaces entries.") {
+	TranspositionTable table(1 << 16, 4);
+	REQUIRE(table.get_size_in_bytes() == 1 << 16);
+	REQUIRE(table.get_hashfull() == 0);
+
+	const ZobristKey key = 0x0123456789ABCDEFULL;
+	TableEntry entry;
+	REQUIRE_FALSE(table.probe(key, entry));
+	table.store(key, uci_to_move("e7e8q"), -321, 5, Bound::LOWER);
+	REQUIRE(table.probe(key, entry));
+	REQUIRE(entry.move == uci_to_move("e7e8q"));
+	REQUIRE(entry.score == -321);
+	REQUIRE(entry.depth == 5);
+	REQUIRE(entry.bound == Bound::LOWER);
+
+	// A shallow bound doesn't replace a deeper result, but an exact score
+	// does, and a missing move keeps the stored one.
+	table.store(key, uci_to_move("a2a3"), 10, 1, Bound::UPPER);
+	REQUIRE(table.probe(key, entry));
+	REQUIRE(entry.depth == 5);
+	table.store(key, kNoMove, 12, 2, Bound::EXACT);
+	REQUIRE(table.probe(key, entry));
+	REQUIRE(entry.depth == 2);
+	REQUIRE(entry.move == uci_to_move("e7e8q"));
+
+	// Fill a cluster with deep entries, then add one more: the shallowest
+	// goes.  Keys in the same cluster differ only in their high bits.
+	const ZobristKey stride = ZobristKey(1) << 40;
+	for(int i = 1; i < 4; i++){
+		table.store(key + i * stride, kNoMove, 0, 10 + i, Bound::EXACT);
+	}
+	table.store(key + 4 * stride, kNoMove, 0, 20, Bound::EXACT);
+	REQUIRE_FALSE(table.probe(key, entry));
+	for(int i = 1; i <= 4; i++){
+		REQUIRE(table.probe(key + i * stride, entry));
+	}
+
+	// Entries from an earlier search are replaced before deeper current ones.
+	table.new_search();
+	table.store(key + 5 * stride, kNoMove, 0, 9, Bound::EXACT);
+	table.store(key + 6 * stride, kNoMove, 0, 9, Bound::EXACT);
+	REQUIRE(table.probe(key + 5 * stride, entry));
+	REQUIRE(table.probe(key + 6 * stride, entry));
+	REQUIRE(table.probe(key + 4 * stride, entry));
+
+	table.clear(3);
+	REQUIRE_FALSE(table.probe(key + 4 * stride, entry));
+}
+
+TEST_CASE("The transposition table reports how full it is.") {
+	TranspositionTable table(1 << 20);
+	const std::size_t entries = table.get_size_in_bytes() / sizeof(TranspositionTable::Cluster) *
+			TranspositionTable::kClusterSize;
+	for(std::size_t i = 0; i < entries; i++){
+		table.store(ZobristKey(i) * 0x9E3779B97F4A7C15ULL + 1, kNoMove, 0, 1, Bound::EXACT);
+	}
+	REQUIRE(table.get_hashfull() > 500);
+	table.new_search();
+	REQUIRE(table.get_hashfull() == 0);
+}
+
+TEST_CASE("A failed resize keeps the transposition table.") {
+	TranspositionTable table(1 << 16);
+	const ZobristKey key = 0x0123456789ABCDEFULL;
+	table.store(key, uci_to_move("e2e4"), 25, 3, Bound::EXACT);
+	REQUIRE_THROWS_AS(table.resize(std::numeric_limits<std::size_t>::max()), const char*);
+	REQUIRE(table.get_size_in_bytes() == 1 << 16);
+	TableEntry entry;
+	REQUIRE(table.probe(key, entry));
+	REQUIRE(entry.move == uci_to_move("e2e4"));
+	table.store(key + 1, kNoMove, 0, 1, Bound::UPPER);
+	REQUIRE(table.probe(key + 1, entry));
+	REQUIRE(table.get_hashfull() >= 0);
+}
+
+TEST_CASE("Concurrent writers never produce an entry with a mismatched key.") {
+	TranspositionTable table(1 << 12);
+	const int kWriters = 4;
+	const int kWrites = 200000;
+	std::vector<std::thread> writers;
+	for(int t = 0; t < kWriters; t++){
+		writers.emplace_back([&table, t](){
+			for(int i = 0; i < kWrites; i++){
+				// The score encodes the key, so any torn entry that passed
+				// verification would be caught by the reader.
+				const ZobristKey key = ZobristKey(i % 512) * 0x9E3779B97F4A7C15ULL;
+				table.store(key, kNoMove, int(key >> 52), t, Bound::EXACT);
+			}
+		});
+	}
+	bool consistent = true;
+	for(int i = 0; i < kWrites; i++){
+		const ZobristKey key = ZobristKey(i % 512) * 0x9E3779B97F4A7C15ULL;
+		TableEntry entry;
+		if(table.probe(key, entry) && entry.score != int(key >> 52)){
+			consistent = false;
+		}
+	}
+	for(std::thread& writer : writers){
+		writer.join();
+	}
+	REQUIRE(consistent);
+}
@@ -7,6 +7,8 @@
 #include "catch.hpp"
 #include <boardlib.h>
 
+#include <algorithm>
+
 using namespace boardlib;
 
 TEST_CASE("Zobrist update gives the same results as raw Zobrist computation.") {
@@ -22,3 +24,90 @@ TEST_CASE("Zobrist update gives the same results as raw Zobrist computation.") {
 }
 
 
+TEST_CASE("Positions reached by play and read from FEN hash the same.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	board.make_move(Move(12, 28));
+	board.make_move(Move(50, 34));
+	BoardState read = BoardState::from_fen(
+			"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq c6 0 2");
+	REQUIRE(board.to_fen() == read.to_fen());
+	REQUIRE(board.get_hash() == read.get_hash());
+}
+
+TEST_CASE("128 bit keys extend 64 bit keys and update the same way.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	ZobristKey128 key = ZobristHasher128::hash(board);
+	REQUIRE(key.low == board.get_hash());
+	std::vector<ZobristKey128> keys = {key};
+	for (const char* uci : {"e2e4", "g8f6", "e4e5", "d7d5", "e5d6", "e7e6",
+			"d6c7", "f8e7", "c7b8q", "f6d5", "b8a8", "e8g8"}) {
+		const MoveRecord record = board.make_move(uci_to_move(uci));
+		key = ZobristHasher128::update(key, record);
+		REQUIRE(key == ZobristHasher128::hash(board));
+		REQUIRE(key.low == board.get_hash());
+		keys.push_back(key);
+	}
+	const NullMoveRecord record = board.make_null_move();
+	REQUIRE(ZobristHasher128::update(key, record) == ZobristHasher128::hash(board));
+
+	// The high halves of distinct positions differ too.
+	std::sort(keys.begin(), keys.end());
+	for (std::size_t i = 1; i < keys.size(); i++) {
+		REQUIRE(keys[i - 1].high != keys[i].high);
+	}
+}
+
+TEST_CASE("Batch hashing agrees with hashing one position at a time.") {
+	std::vector<BoardState> positions;
+	for (const char* fen : {
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+			"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq c6 0 2",
+			"Q1bq1rk1/pp2bppp/4p3/3n4/8/8/PPPP1PPP/RNBQKBNR w KQ - 1 7",
+			"8/8/8/3k4/8/8/8/R3K3 b - - 0 1",
+			"4k3/8/2p5/8/3p4/1P6/P1P2P1P/4K3 w - - 0 1",
+			"1n1Rkb1r/p4ppp/4q3/4p1B1/4P3/8/PPP2PPP/2K5 b k - 1 17"}) {
+		positions.push_back(BoardState::from_fen(fen));
+	}
+	std::vector<ZobristKey> keys(positions.size());
+	ZobristHasher::hash(positions.data(), positions.size(), keys.data());
+	std::vector<ZobristKey128> wide_keys(positions.size());
+	ZobristHasher128::hash(positions.data(), positions.size(), wide_keys.data());
+	for (std::size_t i = 0; i < positions.size(); i++) {
+		REQUIRE(keys[i] == positions[i].get_hash());
+		REQUIRE(wide_keys[i] == ZobristHasher128::hash(positions[i]));
+	}
+}
+
+namespace {
+
+// A prefetch hook that records the keys it is called with.
+void record_key(const void* context, ZobristKey key) {
+	static_cast<std::vector<ZobristKey>*>(const_cast<void*>(context))->push_back(key);
+}
+
+} // namespace
+
+TEST_CASE("Keys after a move are known before it is made.") {
+	BoardState board = BoardState::from_fen(
+			"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	std::vector<ZobristKey> hooked;
+	board.set_prefetch_hook(record_key, &hooked);
+	std::vector<std::string> line = {"e2e4", "g8f6", "e4e5", "d7d5", "e5d6",
+			"e7e6", "d6c7", "f8e7", "c7b8q", "f6d5", "b8a8", "e8g8"};
+	for (const std::string& uci : line) {
+		const Move move = uci_to_move(uci);
+		const ZobristKey key = board.key_after(move);
+		board.make_move(move);
+		REQUIRE(key == board.get_hash());
+		REQUIRE(hooked.back() == key);
+	}
+	board.make_null_move();
+	REQUIRE(hooked.back() == board.get_hash());
+	REQUIRE(hooked.size() == line.size() + 1);
+
+	// Policies without kPrefetch don't call the hook.
+	board.make_move<PerftPolicy>(uci_to_move("d2d4"));
+	REQUIRE(hooked.size() == line.size() + 1);
+}